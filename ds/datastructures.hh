@@ -15,6 +15,7 @@
 #include <set>
 #include <list>
 #include <queue>
+#include <chrono>
 
 // Types for IDs
 using TownID = std::string;
@@ -87,11 +88,101 @@ private:
     std::string msg_;
 };
 
-class Datastructures
+#include "regionindex.hh"
+#include "incrementalmap.hh"
+
+// Approximate heap usage of each index in bytes, disabled features are 0
+struct MemoryUsage
+{
+    std::size_t towns = 0;      // towns_ with names and ids
+    std::size_t names = 0;      // names_
+    std::size_t distances = 0;  // distances_
+    std::size_t regions = 0;    // region aggregate index
+    std::size_t roads = 0;      // vector_of_roads and per-town road lists
+    std::size_t vassals = 0;    // per-town vassal lists
+
+    std::size_t total() const { return towns + names + distances + regions + roads + vassals; }
+};
+
+// Feature policies for BasicDatastructures. An index that is switched off
+// takes no memory and no work in add_town/remove_town. Operations which only
+// used it for speed (alphabetical and distance order, min/max distance,
+// region queries) fall back to going through all towns, operations whose data
+// is not stored at all (roads, vassalships) throw NotImplemented.
+struct AllFeatures
+{
+    static constexpr bool names = true;
+    static constexpr bool distances = true;
+    static constexpr bool regions = true;
+    static constexpr bool roads = true;
+    static constexpr bool vassals = true;
+};
+
+// Route searches only
+struct RoutingFeatures : AllFeatures
+{
+    static constexpr bool names = false;
+    static constexpr bool distances = false;
+    static constexpr bool regions = false;
+    static constexpr bool vassals = false;
+};
+
+// Tax and region queries, no roads
+struct TaxFeatures : AllFeatures
+{
+    static constexpr bool roads = false;
+};
+
+// Storage of the optional features, the disabled versions are empty so that
+// they vanish as (empty) base classes.
+template <bool Enabled> struct town_vassal_fields {};
+template <> struct town_vassal_fields<true> {
+    TownID vassalship_masterid = NO_TOWNID;
+    std::vector<TownID> vassals;
+};
+
+template <bool Enabled> struct town_road_fields {};
+template <> struct town_road_fields<true> {
+    bool visited = false;
+    TownID reached_from_town = NO_TOWNID;
+    std::vector<TownID> roads;
+};
+
+template <bool Enabled> struct name_index {};
+template <> struct name_index<true> {
+    std::set<std::pair<Name, TownID>> names_;
+};
+
+template <bool Enabled> struct distance_index {};
+template <> struct distance_index<true> {
+    std::set<std::pair<Distance, TownID>> distances_;
+    TownID current_min;
+    TownID current_max;
+    Distance current_min_value = NO_DISTANCE;
+    Distance current_max_value = NO_DISTANCE;
+};
+
+template <bool Enabled> struct region_index {};
+template <> struct region_index<true> {
+    RegionIndex regions_;
+};
+
+template <bool Enabled> struct road_index {};
+template <> struct road_index<true> {
+    std::vector<std::pair<TownID, TownID>> vector_of_roads;
+};
+
+// Member definitions are in datastructures.tpp, included at the end of this
+// file. The presets above are instantiated once in datastructures.cc.
+template <typename Policy>
+class BasicDatastructures : private name_index<Policy::names>,
+                            private distance_index<Policy::distances>,
+                            private region_index<Policy::regions>,
+                            private road_index<Policy::roads>
 {
 public:
-    Datastructures();
-    ~Datastructures();
+    BasicDatastructures();
+    ~BasicDatastructures();
 
     // Estimate of performance: ϴ(1)
     // Short rationale for estimate: size() is constant
@@ -225,36 +316,89 @@ public:
     // time complexity is O(n+k)
     std::vector<TownID> road_cycle_route(TownID startid);
 
+    // Region aggregate operations, rectangles are given by two opposite corners
+    // and circles by center and radius (distance as in towns_nearest). Tax
+    // totals are 64-bit so that sums of many int taxes do not overflow.
+
+    // Estimate of performance: O(sqrt(n))
+    // Short rationale for estimate: k-d tree range search, subtrees inside
+    // the region are summed from their stored aggregates.
+    long long tax_in_region(Coord corner1, Coord corner2);
+
+    // Estimate of performance: O(sqrt(n))
+    // Short rationale for estimate: same as the rectangle version
+    long long tax_in_region(Coord center, Distance radius);
+
+    // Estimate of performance: O(sqrt(n))
+    // Short rationale for estimate: k-d tree range search, subtrees inside
+    // the region are counted from their stored aggregates.
+    unsigned int count_in_region(Coord corner1, Coord corner2);
+
+    // Estimate of performance: O(sqrt(n))
+    // Short rationale for estimate: same as the rectangle version
+    unsigned int count_in_region(Coord center, Distance radius);
+
+    // Estimate of performance: O((sqrt(n) + k)log(n))
+    // Short rationale for estimate: best-first search by subtree maximum tax,
+    // priority queue operations are logarithmic.
+    std::vector<TownID> top_k_tax_in_region(Coord corner1, Coord corner2, unsigned int k);
+
+    // Estimate of performance: O((sqrt(n) + k)log(n))
+    // Short rationale for estimate: same as the rectangle version
+    std::vector<TownID> top_k_tax_in_region(Coord center, Distance radius, unsigned int k);
+
+    // Estimate of performance: ϴ(n)
+    // Short rationale for estimate: every town and index entry is visited once
+    MemoryUsage memory_usage();
+
+    // Does one slice of compaction, lasting roughly budget, and returns true when
+    // a full pass is complete. Per-town vectors are shrunk and towns_ is migrated
+    // into a right-sized table a few hash buckets at a time, the region index
+    // builds its compacted tree in steps of at most a few hundred towns.
+    // Containers are skipped when removals have not left them mostly unused.
+    // The budget does NOT bound these single steps, each O(n) in one call:
+    // - allocating the new bucket array of towns_, and the new map, node and
+    //   order vectors of the region index
+    // - freeing the old bucket array of towns_ and the old node vector and
+    //   bucket array of the region index, together with whatever the memory
+    //   allocator then returns to the system (tens of milliseconds after
+    //   shrinking a million towns to a hundred thousand)
+    // - vector_of_roads.shrink_to_fit(), which moves every road once
+    // Towns changed during a region index compaction are also reinserted in
+    // one call, see RegionIndex::compact().
+    // Estimate of performance: O(nlog(n)) per full pass
+    // Short rationale for estimate: every town is visited once, the region
+    // index partitions the towns once on every level of its tree.
+    bool compact(std::chrono::microseconds budget);
+
 private:
 
-    struct town_data {
+    struct town_data : town_vassal_fields<Policy::vassals>,
+                       town_road_fields<Policy::roads> {
         Name name_;
         Coord coord_;
         int tax_;
-        TownID vassalship_masterid = NO_TOWNID;
-        std::vector<TownID> vassals;
-        Distance distance_;
-        bool visited = false;
-        TownID reached_from_town = NO_TOWNID;
-        std::vector<TownID> roads;
 
     };
-    std::unordered_map<TownID, town_data> towns_;
+    IncrementalMap<TownID, town_data> towns_;
     Distance calculate_distance(TownID, Coord);
     void update_min_max();
 
-    TownID current_min;
-    TownID current_max;
-    Distance current_min_value = NO_DISTANCE;
-    Distance current_max_value = NO_DISTANCE;
-
     void recursive_tax_path(TownID, std::vector<TownID> &v);
     void recursive_longest_tax_path(TownID id, int& longest, int current_depth, TownID &bottom_vassal);
     int recursive_net_tax(TownID);
-    std::set<std::pair<Name, TownID>> names_;
-    std::set<std::pair<Distance, TownID>> distances_;
 
-    std::vector<std::pair<TownID, TownID>> vector_of_roads;
+    // Region queries without the index, one pass over all towns
+    template <typename Region>
+    std::pair<unsigned int, long long> scan_region(Region const& region);
+    template <typename Region>
+    std::vector<TownID> scan_top_k(Region const& region, unsigned int k);
+
+    // Progress of compact() between calls
+    enum class compaction_phase { town_vectors, roads, towns, regions };
+    compaction_phase compaction_phase_ = compaction_phase::town_vectors;
+    std::size_t compaction_bucket_ = 0;
+
     std::vector<TownID> bfs(TownID town1, TownID town2);
     bool dfs(TownID town1, TownID parent, TownID start_town, std::vector<TownID>& v);
     void set_visited_false();
@@ -262,4 +406,13 @@ private:
 
 };
 
+extern template class BasicDatastructures<AllFeatures>;
+extern template class BasicDatastructures<RoutingFeatures>;
+extern template class BasicDatastructures<TaxFeatures>;
+
+// All features enabled
+using Datastructures = BasicDatastructures<AllFeatures>;
+
+#include "datastructures.tpp"
+
 #endif // DATASTRUCTURES_HH
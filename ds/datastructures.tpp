@@ -0,0 +1,870 @@
+// Datastructures.tpp
+//
+// Student name: Tuomas Mäkinen
+//
+// Member definitions of BasicDatastructures, included at the end of
+// datastructures.hh so that any policy can be instantiated.
+
+#include "memoryusage.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <unordered_map>
+
+template <typename Policy>
+BasicDatastructures<Policy>::BasicDatastructures()
+{
+
+}
+
+template <typename Policy>
+BasicDatastructures<Policy>::~BasicDatastructures()
+{
+
+}
+
+template <typename Policy>
+unsigned int BasicDatastructures<Policy>::town_count()
+{
+    return towns_.size();
+}
+
+template <typename Policy>
+void BasicDatastructures<Policy>::clear_all()
+{
+    towns_.clear();
+    if constexpr (Policy::names) {
+        this->names_.clear();
+    }
+    if constexpr (Policy::distances) {
+        this->distances_.clear();
+        update_min_max();
+    }
+    if constexpr (Policy::regions) {
+        this->regions_.clear();
+    }
+    if constexpr (Policy::roads) {
+        this->vector_of_roads.clear();
+    }
+}
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::add_town(TownID id, const Name &name, Coord coord, int tax)
+{
+    if (towns_.count(id) != 0) {
+        return false;
+    }
+    town_data new_town;
+    new_town.name_ = name;
+    new_town.coord_ = coord;
+    new_town.tax_ = tax;
+    towns_.insert({id, new_town});
+
+    if constexpr (Policy::distances) {
+        int distance = std::floor(sqrt(pow(coord.x, 2) + pow(coord.y, 2)));
+        if (this->current_min_value == NO_DISTANCE or distance < this->current_min_value) {
+            this->current_min = id;
+            this->current_min_value = distance;
+        }
+        if (this->current_max_value == NO_DISTANCE or distance > this->current_max_value) {
+            this->current_max = id;
+            this->current_max_value = distance;
+        }
+        this->distances_.insert(std::make_pair(distance, id));
+    }
+    if constexpr (Policy::names) {
+        this->names_.insert(std::make_pair(name, id));
+    }
+    if constexpr (Policy::regions) {
+        this->regions_.insert(id, coord, tax);
+    }
+    return true;
+}
+
+template <typename Policy>
+Name BasicDatastructures<Policy>::get_town_name(TownID id)
+{
+    if (towns_.count(id) == 0) {
+        return NO_NAME;
+    }
+    return towns_.at(id).name_;
+}
+
+template <typename Policy>
+Coord BasicDatastructures<Policy>::get_town_coordinates(TownID id)
+{
+    if (towns_.count(id) == 0) {
+        return NO_COORD;
+    }
+    return towns_.at(id).coord_;
+}
+
+template <typename Policy>
+int BasicDatastructures<Policy>::get_town_tax(TownID id)
+{
+    if (towns_.count(id) == 0) {
+        return NO_VALUE;
+    }
+    return towns_.at(id).tax_;
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::all_towns()
+{
+    std::vector<TownID> all_towns_vec;
+    std::transform(towns_.begin(), towns_.end(),
+                   std::back_inserter(all_towns_vec),
+                   [](const typename std::unordered_map<TownID, town_data>::value_type &pair){return pair.first;});
+    return all_towns_vec;
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::find_towns(const Name &name)
+{
+    std::vector<TownID> matching_towns;
+    for (auto& town : towns_) {
+        if (town.second.name_ == name)
+        {
+            matching_towns.push_back(town.first);
+        }
+    }
+    return matching_towns;
+}
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::change_town_name(TownID id, const Name &newname)
+{
+    if (towns_.count(id) == 0) {
+        return false;
+    }
+    towns_.at(id).name_ = newname;
+    return true;
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::towns_alphabetically()
+{
+    std::vector<TownID> sorted;
+    if constexpr (Policy::names) {
+        for (auto &i : this->names_) {
+            sorted.push_back(i.second);
+        }
+    }
+    else {
+        std::vector<std::pair<Name, TownID>> names;
+        for (auto &i : towns_) {
+            names.push_back(std::make_pair(i.second.name_, i.first));
+        }
+        std::sort(names.begin(), names.end());
+        for (auto &i : names) {
+            sorted.push_back(i.second);
+        }
+    }
+    return sorted;
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::towns_distance_increasing()
+{
+    std::vector<TownID> sorted;
+    if constexpr (Policy::distances) {
+        for (auto &i : this->distances_) {
+            sorted.push_back(i.second);
+        }
+    }
+    else {
+        std::vector<std::pair<Distance, TownID>> distances;
+        for (auto &i : towns_) {
+            distances.push_back(std::make_pair(calculate_distance(i.first, {0, 0}), i.first));
+        }
+        std::sort(distances.begin(), distances.end());
+        for (auto &i : distances) {
+            sorted.push_back(i.second);
+        }
+    }
+    return sorted;
+}
+
+template <typename Policy>
+TownID BasicDatastructures<Policy>::min_distance()
+{
+    if (town_count() == 0) {
+        return NO_TOWNID;
+    }
+    if constexpr (Policy::distances) {
+        return this->current_min;
+    }
+    else {
+        std::pair<Distance, TownID> min = {std::numeric_limits<Distance>::max(), NO_TOWNID};
+        for (auto &i : towns_) {
+            min = std::min(min, std::make_pair(calculate_distance(i.first, {0, 0}), i.first));
+        }
+        return min.second;
+    }
+}
+
+template <typename Policy>
+TownID BasicDatastructures<Policy>::max_distance()
+{
+    if (town_count() == 0) {
+        return NO_TOWNID;
+    }
+    if constexpr (Policy::distances) {
+        return this->current_max;
+    }
+    else {
+        std::pair<Distance, TownID> max = {NO_DISTANCE, NO_TOWNID};
+        for (auto &i : towns_) {
+            max = std::max(max, std::make_pair(calculate_distance(i.first, {0, 0}), i.first));
+        }
+        return max.second;
+    }
+}
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::add_vassalship(TownID vassalid, TownID masterid)
+{
+    if constexpr (not Policy::vassals) {
+        throw NotImplemented("add_vassalship");
+    }
+    else {
+        if (towns_.count(vassalid) == 0 or towns_.count(masterid) == 0) { return false; }
+        if (towns_.at(vassalid).vassalship_masterid != NO_TOWNID) { return false; }
+        else if (masterid != vassalid) {
+            towns_.at(vassalid).vassalship_masterid = masterid;
+            towns_.at(masterid).vassals.push_back(vassalid);
+            return true;
+        }
+        return false;
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::get_town_vassals(TownID id)
+{
+    if constexpr (not Policy::vassals) {
+        throw NotImplemented("get_town_vassals");
+    }
+    else {
+        if (towns_.count(id) == 0) {return {NO_TOWNID};}
+
+        return towns_.at(id).vassals;
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::taxer_path(TownID id)
+{
+    if constexpr (not Policy::vassals) {
+        throw NotImplemented("taxer_path");
+    }
+    else {
+        if (towns_.count(id) == 0) {return {NO_TOWNID};}
+        std::vector<TownID> path;
+        path.push_back(id);
+        recursive_tax_path(id, path);
+        return path;
+    }
+}
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::remove_town(TownID id)
+{
+    if (towns_.count(id) == 0) {return false;}
+
+    // Remove roads leading to deleted town while it still exists, the list
+    // is copied because remove_road() erases from it
+    if constexpr (Policy::roads) {
+        std::vector<TownID> neighbours = towns_.at(id).roads;
+        for (auto& neighbour : neighbours) {
+            remove_road(id, neighbour);
+        }
+    }
+    if constexpr (Policy::vassals) {
+        TownID master = towns_.at(id).vassalship_masterid;
+        if (master != NO_TOWNID)
+        {
+            for (auto& i : towns_.at(id).vassals)
+            {
+                towns_.at(i).vassalship_masterid = master;
+                towns_.at(master).vassals.push_back(i);
+            }
+            auto iter = std::find(towns_.at(master).vassals.begin(),
+                                  towns_.at(master).vassals.end(), id);
+            towns_.at(master).vassals.erase(iter);
+        }
+        else {
+            // Vassals of a top-level town become top-level towns
+            for (auto& i : towns_.at(id).vassals) {
+                towns_.at(i).vassalship_masterid = NO_TOWNID;
+            }
+        }
+    }
+    if constexpr (Policy::regions) {
+        this->regions_.erase(id);
+    }
+    towns_.erase(id);
+    if constexpr (Policy::names) {
+        auto iter = std::find_if(this->names_.begin(),
+                              this->names_.end(), [id](const std::pair<Name, TownID>& p){ return p.second == id;});
+        this->names_.erase(iter);
+    }
+    if constexpr (Policy::distances) {
+        auto iter2 = std::find_if(this->distances_.begin(),
+                              this->distances_.end(), [id](const std::pair<Distance, TownID>& p){ return p.second == id;});
+        this->distances_.erase(iter2);
+        update_min_max();
+    }
+    return true;
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::towns_nearest(Coord coord)
+{
+    std::set<std::pair<Distance,TownID>> distances;
+    for (auto &i : towns_) {
+        Distance distance = calculate_distance(i.first, coord);
+        distances.insert(std::make_pair(distance, i.first));
+    }
+    std::vector<TownID> sorted;
+    for (auto &i : distances) {
+        sorted.push_back(i.second);
+    }
+    return sorted;
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::longest_vassal_path(TownID id)
+{
+    if constexpr (not Policy::vassals) {
+        throw NotImplemented("longest_vassal_path");
+    }
+    else {
+        if (towns_.count(id) == 0) {return {NO_TOWNID};}
+
+        std::vector<TownID> v;
+        int depth = 0;
+        TownID bottom_vassal = NO_TOWNID;
+
+        recursive_longest_tax_path(id, depth, 1, bottom_vassal);
+        v.push_back(bottom_vassal);
+        recursive_tax_path(bottom_vassal, v);
+
+        // Cutting the whole taxer path into the wanted one
+        auto it = std::find(v.begin(), v.end(), id);
+        std::vector<TownID> longest_path;
+        std::copy(v.begin(), it, std::back_inserter(longest_path));
+        longest_path.push_back(id);
+        std::reverse(longest_path.begin(), longest_path.end());
+
+        return longest_path;
+    }
+}
+
+template <typename Policy>
+int BasicDatastructures<Policy>::total_net_tax(TownID id)
+{
+    if constexpr (not Policy::vassals) {
+        throw NotImplemented("total_net_tax");
+    }
+    else {
+        if (towns_.count(id) == 0) {return NO_VALUE;}
+        if (towns_.at(id).vassalship_masterid == NO_TOWNID) {
+            return recursive_net_tax(id);
+        }
+        else {
+            int total = recursive_net_tax(id);
+            return (total - std::floor(total * 0.1));
+        }
+    }
+}
+
+template <typename Policy>
+Distance BasicDatastructures<Policy>::calculate_distance(TownID id, Coord coord)
+{
+    if (towns_.count(id) == 0) {return NO_DISTANCE;}
+    Distance distance = std::floor(sqrt(pow(towns_.at(id).coord_.x - coord.x, 2)
+                                               + pow(towns_.at(id).coord_.y - coord.y, 2)));
+    return distance;
+}
+
+template <typename Policy>
+void BasicDatastructures<Policy>::update_min_max()
+{
+    if constexpr (Policy::distances) {
+        if (this->distances_.empty()) {
+            this->current_min = NO_TOWNID;
+            this->current_min_value = NO_DISTANCE;
+            this->current_max = NO_TOWNID;
+            this->current_max_value = NO_DISTANCE;
+            return;
+        }
+        this->current_min = this->distances_.begin()->second;
+        this->current_min_value = this->distances_.begin()->first;
+        this->current_max = this->distances_.rbegin()->second;
+        this->current_max_value = this->distances_.rbegin()->first;
+    }
+}
+
+template <typename Policy>
+void BasicDatastructures<Policy>::recursive_tax_path(TownID id, std::vector<TownID> &v)
+{
+    if constexpr (Policy::vassals) {
+        TownID master = towns_.at(id).vassalship_masterid;
+        if (master == NO_TOWNID) {
+            return;
+        }
+        v.push_back(master);
+        return recursive_tax_path(master, v);
+    }
+}
+
+template <typename Policy>
+void BasicDatastructures<Policy>::recursive_longest_tax_path(TownID id, int &longest, int current_depth, TownID &bottom_vassal)
+{
+    if constexpr (Policy::vassals) {
+        if (towns_.at(id).vassals.size() == 0) {
+            if (current_depth > longest) {
+                longest = current_depth;
+                bottom_vassal = id;
+            }
+        }
+        current_depth++;
+        for (auto& vassal : towns_.at(id).vassals) {
+            recursive_longest_tax_path(vassal, longest, current_depth, bottom_vassal);
+        }
+    }
+}
+
+template <typename Policy>
+int BasicDatastructures<Policy>::recursive_net_tax(TownID id)
+{
+    if constexpr (not Policy::vassals) {
+        return towns_.at(id).tax_;
+    }
+    else {
+        if (towns_.at(id).vassals.size() == 0) {
+            return towns_.at(id).tax_;
+        }
+        int vassal_tax = 0;
+        for (auto& i : towns_.at(id).vassals) {
+            vassal_tax += recursive_net_tax(i) * 0.1;
+        }
+        return vassal_tax + towns_.at(id).tax_;
+    }
+}
+
+template <typename Policy>
+void BasicDatastructures<Policy>::clear_roads()
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("clear_roads");
+    }
+    else {
+        for (auto& i : towns_) {
+            i.second.roads.clear();
+        }
+        this->vector_of_roads.clear();
+    }
+}
+
+template <typename Policy>
+std::vector<std::pair<TownID, TownID>> BasicDatastructures<Policy>::all_roads()
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("all_roads");
+    }
+    else {
+        return this->vector_of_roads;
+    }
+}
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::add_road(TownID town1, TownID town2)
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("add_road");
+    }
+    else {
+        if (towns_.count(town1) == 0 or towns_.count(town2) == 0) {return false;}
+        if (std::find(towns_.at(town1).roads.begin(), towns_.at(town1).roads.end(), town2) != towns_.at(town1).roads.end()) {
+            return false;
+        }
+        towns_.at(town1).roads.push_back(town2);
+        towns_.at(town2).roads.push_back(town1);
+        int x = town1.compare(town2);
+        if (x > 0) {
+            std::pair town_pair = std::make_pair(town2, town1);
+            this->vector_of_roads.push_back(town_pair);
+        }
+        else {
+            std::pair town_pair = std::make_pair(town1, town2);
+            this->vector_of_roads.push_back(town_pair);
+        }
+        return true;
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::get_roads_from(TownID id)
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("get_roads_from");
+    }
+    else {
+        auto search = towns_.find(id);
+        if (search == towns_.end()) {
+            return {NO_TOWNID};
+        }
+        return towns_.at(id).roads;
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::any_route(TownID fromid, TownID toid)
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("any_route");
+    }
+    else {
+        if (towns_.count(fromid) == 0 or towns_.count(toid) == 0) {return {NO_TOWNID};}
+        set_visited_false();
+        std::vector<TownID> path = bfs(fromid, toid);
+        return path;
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::bfs(TownID town1, TownID town2)
+{
+    if constexpr (Policy::roads) {
+        if (town1 == town2) {
+            return {town1};
+        }
+        std::vector<TownID> path;
+        path.push_back(town1);
+        std::deque<std::vector<TownID>> queue;
+        queue.push_back(path);
+
+        while (!queue.empty()) {
+            path = queue.front();
+            queue.pop_front();
+            TownID last_node = *path.rbegin();
+
+            if (last_node == town2) {
+                return path;
+            }
+            for (auto& i : towns_.at(last_node).roads) {
+                if (not towns_.at(i).visited) {
+                    towns_.at(i).visited = true;
+                    std::vector<TownID> new_path(path.begin(), path.end());
+                    new_path.push_back(i);
+                    queue.push_back(new_path);
+                }
+            }
+        }
+    }
+    return {};
+}
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::dfs(TownID town1, TownID parent, TownID start_town, std::vector<TownID>& v)
+{
+    if constexpr (Policy::roads) {
+        towns_.at(town1).visited = true;
+        if (town1 != start_town) {
+            towns_.at(town1).reached_from_town = parent;
+        }
+        for (auto& i : towns_.at(town1).roads) {
+            if (not towns_.at(i).visited) {
+                if (dfs(i, town1, start_town, v)) {
+                    v.push_back(i);
+                    return true;
+                }
+            }
+            else if (i != parent) {
+                v.push_back(i);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+template <typename Policy>
+void BasicDatastructures<Policy>::set_visited_false()
+{
+    if constexpr (Policy::roads) {
+        for (auto& i : towns_) {
+            i.second.visited = false;
+            i.second.reached_from_town = NO_TOWNID;
+        }
+    }
+}
+
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::remove_road(TownID town1, TownID town2)
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("remove_road");
+    }
+    else {
+        if (towns_.count(town1) == 0 or towns_.count(town2) == 0) {return false;}
+
+        auto iter1 = std::find(towns_.at(town1).roads.begin(), towns_.at(town1).roads.end(), town2);
+        if (iter1 != towns_.at(town1).roads.end()) {
+            towns_.at(town1).roads.erase(iter1);
+            auto iter2 = std::find(towns_.at(town2).roads.begin(), towns_.at(town2).roads.end(), town1);
+            towns_.at(town2).roads.erase(iter2);
+
+            // Finding correct pair to delete
+            int x = town1.compare(town2);
+            if (x > 0) {
+                auto pair = std::make_pair(town2, town1);
+                auto i = std::find(this->vector_of_roads.begin(), this->vector_of_roads.end(), pair);
+                this->vector_of_roads.erase(i);
+            }
+            else {
+                auto pair = std::make_pair(town1, town2);
+                auto i = std::find(this->vector_of_roads.begin(), this->vector_of_roads.end(), pair);
+                this->vector_of_roads.erase(i);
+            }
+            return true;
+        }
+        else {
+            return false;
+        }
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::least_towns_route(TownID fromid, TownID toid)
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("least_towns_route");
+    }
+    else {
+        if (towns_.count(fromid) == 0 or towns_.count(toid) == 0) {return {NO_TOWNID};}
+        set_visited_false();
+        std::vector<TownID> path = bfs(fromid, toid);
+        return path;
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::road_cycle_route(TownID startid)
+{
+    if constexpr (not Policy::roads) {
+        throw NotImplemented("road_cycle_route");
+    }
+    else {
+        if (towns_.count(startid) == 0) {return {NO_TOWNID};}
+        set_visited_false();
+
+        std::vector<TownID> path;
+        dfs(startid, NO_TOWNID, startid, path);
+        if (path.empty()) {return {};}
+        path.push_back(startid);
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+}
+
+template <typename Policy>
+long long BasicDatastructures<Policy>::tax_in_region(Coord corner1, Coord corner2)
+{
+    if constexpr (Policy::regions) {
+        return this->regions_.tax_in_rectangle(corner1, corner2);
+    }
+    else {
+        return scan_region(RegionIndex::make_rectangle(corner1, corner2)).second;
+    }
+}
+
+template <typename Policy>
+long long BasicDatastructures<Policy>::tax_in_region(Coord center, Distance radius)
+{
+    if constexpr (Policy::regions) {
+        return this->regions_.tax_in_circle(center, radius);
+    }
+    else {
+        return scan_region(RegionIndex::make_circle(center, radius)).second;
+    }
+}
+
+template <typename Policy>
+unsigned int BasicDatastructures<Policy>::count_in_region(Coord corner1, Coord corner2)
+{
+    if constexpr (Policy::regions) {
+        return this->regions_.count_in_rectangle(corner1, corner2);
+    }
+    else {
+        return scan_region(RegionIndex::make_rectangle(corner1, corner2)).first;
+    }
+}
+
+template <typename Policy>
+unsigned int BasicDatastructures<Policy>::count_in_region(Coord center, Distance radius)
+{
+    if constexpr (Policy::regions) {
+        return this->regions_.count_in_circle(center, radius);
+    }
+    else {
+        return scan_region(RegionIndex::make_circle(center, radius)).first;
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::top_k_tax_in_region(Coord corner1, Coord corner2, unsigned int k)
+{
+    if constexpr (Policy::regions) {
+        return this->regions_.top_k_tax_in_rectangle(corner1, corner2, k);
+    }
+    else {
+        return scan_top_k(RegionIndex::make_rectangle(corner1, corner2), k);
+    }
+}
+
+template <typename Policy>
+std::vector<TownID> BasicDatastructures<Policy>::top_k_tax_in_region(Coord center, Distance radius, unsigned int k)
+{
+    if constexpr (Policy::regions) {
+        return this->regions_.top_k_tax_in_circle(center, radius, k);
+    }
+    else {
+        return scan_top_k(RegionIndex::make_circle(center, radius), k);
+    }
+}
+
+template <typename Policy>
+MemoryUsage BasicDatastructures<Policy>::memory_usage()
+{
+    MemoryUsage usage;
+    usage.towns = towns_.table_bytes();
+    for (auto& i : towns_) {
+        usage.towns += heap_bytes(i.first) + heap_bytes(i.second.name_);
+        if constexpr (Policy::roads) {
+            usage.towns += heap_bytes(i.second.reached_from_town);
+            usage.roads += heap_bytes(i.second.roads);
+        }
+        if constexpr (Policy::vassals) {
+            usage.towns += heap_bytes(i.second.vassalship_masterid);
+            usage.vassals += heap_bytes(i.second.vassals);
+        }
+    }
+    if constexpr (Policy::names) {
+        usage.names = heap_bytes(this->names_);
+    }
+    if constexpr (Policy::distances) {
+        usage.distances = heap_bytes(this->distances_)
+                + heap_bytes(this->current_min) + heap_bytes(this->current_max);
+    }
+    if constexpr (Policy::regions) {
+        usage.regions = this->regions_.memory_usage();
+    }
+    if constexpr (Policy::roads) {
+        usage.roads += heap_bytes(this->vector_of_roads);
+    }
+    return usage;
+}
+
+template <typename Policy>
+bool BasicDatastructures<Policy>::compact(std::chrono::microseconds budget)
+{
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    auto out_of_time = [deadline](){ return std::chrono::steady_clock::now() >= deadline; };
+
+    if (compaction_phase_ == compaction_phase::town_vectors) {
+        // If towns_ was rehashed between calls, some towns are visited twice
+        // or only on the next pass, which is harmless
+        while (compaction_bucket_ < towns_.bucket_count()) {
+            for (auto iter = towns_.begin(compaction_bucket_); iter != towns_.end(compaction_bucket_); ++iter) {
+                if constexpr (Policy::roads) {
+                    if (wastes_half(iter->second.roads)) {
+                        iter->second.roads.shrink_to_fit();
+                    }
+                }
+                if constexpr (Policy::vassals) {
+                    if (wastes_half(iter->second.vassals)) {
+                        iter->second.vassals.shrink_to_fit();
+                    }
+                }
+            }
+            ++compaction_bucket_;
+            if (compaction_bucket_ % 64 == 0 and out_of_time()) {
+                return false;
+            }
+        }
+        compaction_bucket_ = 0;
+        compaction_phase_ = compaction_phase::roads;
+        if (out_of_time()) {return false;}
+    }
+    if (compaction_phase_ == compaction_phase::roads) {
+        if constexpr (Policy::roads) {
+            if (wastes_half(this->vector_of_roads)) {
+                this->vector_of_roads.shrink_to_fit();
+            }
+        }
+        compaction_phase_ = compaction_phase::towns;
+        if (out_of_time()) {return false;}
+    }
+    if (compaction_phase_ == compaction_phase::towns) {
+        // Lookups check both tables until the migration is complete
+        if (towns_.migrating() or towns_.wastes_buckets()) {
+            towns_.start_migration();
+            while (not towns_.migrate(64)) {
+                if (out_of_time()) {return false;}
+            }
+        }
+        compaction_phase_ = compaction_phase::regions;
+        if (out_of_time()) {return false;}
+    }
+    if constexpr (Policy::regions) {
+        if (this->regions_.needs_compaction() and not this->regions_.compact(deadline)) {
+            return false;
+        }
+    }
+    compaction_phase_ = compaction_phase::town_vectors;
+    return true;
+}
+
+template <typename Policy>
+template <typename Region>
+std::pair<unsigned int, long long> BasicDatastructures<Policy>::scan_region(Region const& region)
+{
+    unsigned int count = 0;
+    long long tax_sum = 0;
+    for (auto& i : towns_) {
+        if (region.contains(i.second.coord_)) {
+            ++count;
+            tax_sum += i.second.tax_;
+        }
+    }
+    return std::make_pair(count, tax_sum);
+}
+
+template <typename Policy>
+template <typename Region>
+std::vector<TownID> BasicDatastructures<Policy>::scan_top_k(Region const& region, unsigned int k)
+{
+    std::vector<std::pair<int, TownID>> inside;
+    for (auto& i : towns_) {
+        if (region.contains(i.second.coord_)) {
+            inside.push_back(std::make_pair(i.second.tax_, i.first));
+        }
+    }
+    // Same order as the index: tax decreasing, ties by TownID
+    auto higher_tax = [](std::pair<int, TownID> const& a, std::pair<int, TownID> const& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    };
+    auto last = inside.begin() + std::min<std::size_t>(k, inside.size());
+    std::partial_sort(inside.begin(), last, inside.end(), higher_tax);
+    std::vector<TownID> result;
+    for (auto i = inside.begin(); i != last; ++i) {
+        result.push_back(i->second);
+    }
+    return result;
+}
@@ -0,0 +1,344 @@
+// Dsload.cc
+//
+// Student name: Tuomas Mäkinen
+//
+// Load generator for dsserver. Fills the server with towns and roads, then
+// runs clients that keep a fixed number of requests in flight and reports
+// throughput and latency percentiles.
+// Usage: dsload <socket path> [clients] [pipeline depth] [requests per client]
+//               [towns] [write percent]
+
+#include "queryprotocol.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Towns are placed on this square, query regions are REGION_SIZE wide
+int const AREA_SIZE = 10000;
+int const REGION_SIZE = 500;
+
+struct load_settings
+{
+    std::string socket_path;
+    unsigned int clients = 4;
+    unsigned int depth = 32;
+    unsigned int requests = 100000;
+    unsigned int towns = 10000;
+    unsigned int write_percent = 10;
+};
+
+struct client_result
+{
+    std::vector<double> latencies; // Microseconds
+    unsigned int errors = 0;
+    bool connected = true;
+};
+
+int connect_to(std::string const& socket_path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+TownID town_id(unsigned int index)
+{
+    return "t" + std::to_string(index);
+}
+
+MessageWriter request(std::uint32_t tag, Operation op)
+{
+    MessageWriter message;
+    message.put_u32(tag);
+    message.put_u8(static_cast<std::uint8_t>(op));
+    return message;
+}
+
+// Random request of the mix. Writes add and remove towns, add roads and rename,
+// reads are point lookups, region queries and road lists.
+MessageWriter random_request(std::uint32_t tag, load_settings const& settings, std::minstd_rand& engine)
+{
+    auto random_town = [&](){ return town_id(engine() % settings.towns); };
+    auto random_coord = [&](){ return Coord{static_cast<int>(engine() % AREA_SIZE),
+                                            static_cast<int>(engine() % AREA_SIZE)}; };
+
+    if (engine() % 100 < settings.write_percent) {
+        // Writes also use ids beyond the populated ones, so towns come and go
+        auto any_town = [&](){ return town_id(engine() % (2 * settings.towns)); };
+        switch (engine() % 4) {
+        case 0: {
+            MessageWriter message = request(tag, Operation::add_town);
+            TownID id = any_town();
+            message.put_string(id);
+            message.put_string("town" + id);
+            message.put_coord(random_coord());
+            message.put_int(engine() % 1000);
+            return message;
+        }
+        case 1: {
+            MessageWriter message = request(tag, Operation::remove_town);
+            message.put_string(any_town());
+            return message;
+        }
+        case 2: {
+            MessageWriter message = request(tag, Operation::add_road);
+            message.put_string(any_town());
+            message.put_string(any_town());
+            return message;
+        }
+        default: {
+            MessageWriter message = request(tag, Operation::change_town_name);
+            message.put_string(any_town());
+            message.put_string("renamed" + std::to_string(engine() % 1000));
+            return message;
+        }
+        }
+    }
+    switch (engine() % 6) {
+    case 0: {
+        MessageWriter message = request(tag, Operation::get_town_tax);
+        message.put_string(random_town());
+        return message;
+    }
+    case 1: {
+        MessageWriter message = request(tag, Operation::get_town_coordinates);
+        message.put_string(random_town());
+        return message;
+    }
+    case 2: {
+        MessageWriter message = request(tag, Operation::count_in_rectangle);
+        Coord corner = random_coord();
+        message.put_coord(corner);
+        message.put_coord({corner.x + REGION_SIZE, corner.y + REGION_SIZE});
+        return message;
+    }
+    case 3: {
+        MessageWriter message = request(tag, Operation::tax_in_circle);
+        message.put_coord(random_coord());
+        message.put_int(REGION_SIZE / 2);
+        return message;
+    }
+    case 4: {
+        MessageWriter message = request(tag, Operation::top_k_tax_in_rectangle);
+        Coord corner = random_coord();
+        message.put_coord(corner);
+        message.put_coord({corner.x + REGION_SIZE, corner.y + REGION_SIZE});
+        message.put_u32(5);
+        return message;
+    }
+    default: {
+        MessageWriter message = request(tag, Operation::get_roads_from);
+        message.put_string(random_town());
+        return message;
+    }
+    }
+}
+
+// Sends the messages pipelined and waits for all responses, counts errors
+bool send_and_wait(int fd, std::vector<MessageWriter> const& messages, unsigned int& errors)
+{
+    std::string out;
+    for (auto& message : messages) {
+        message.append_frame(out);
+    }
+    if (not write_all(fd, out)) {
+        return false;
+    }
+    std::string in;
+    std::vector<std::string> payloads;
+    while (payloads.size() < messages.size()) {
+        if (not read_some(fd, in) or not take_frames(in, payloads)) {
+            return false;
+        }
+    }
+    for (auto& payload : payloads) {
+        MessageReader response(payload);
+        response.get_u32();
+        if (static_cast<Status>(response.get_u8()) != Status::ok) {
+            ++errors;
+        }
+    }
+    return true;
+}
+
+// Adds the towns and a road from every town to the next one
+bool populate(load_settings const& settings)
+{
+    int fd = connect_to(settings.socket_path);
+    if (fd < 0) {
+        return false;
+    }
+    std::minstd_rand engine(1);
+    unsigned int errors = 0;
+    bool ok = send_and_wait(fd, {request(0, Operation::clear_all)}, errors);
+
+    unsigned int const chunk = 1000;
+    for (unsigned int first = 0; ok and first < settings.towns; first += chunk) {
+        std::vector<MessageWriter> messages;
+        for (unsigned int i = first; i < std::min(first + chunk, settings.towns); ++i) {
+            MessageWriter message = request(i, Operation::add_town);
+            message.put_string(town_id(i));
+            message.put_string("town" + std::to_string(i));
+            message.put_coord({static_cast<int>(engine() % AREA_SIZE), static_cast<int>(engine() % AREA_SIZE)});
+            message.put_int(engine() % 1000);
+            messages.push_back(message);
+        }
+        ok = send_and_wait(fd, messages, errors);
+    }
+    for (unsigned int first = 1; ok and first < settings.towns; first += chunk) {
+        std::vector<MessageWriter> messages;
+        for (unsigned int i = first; i < std::min(first + chunk, settings.towns); ++i) {
+            MessageWriter message = request(i, Operation::add_road);
+            message.put_string(town_id(i - 1));
+            message.put_string(town_id(i));
+            messages.push_back(message);
+        }
+        ok = send_and_wait(fd, messages, errors);
+    }
+    ::close(fd);
+    return ok and errors == 0;
+}
+
+void run_client(load_settings const& settings, unsigned int seed, client_result& result)
+{
+    int fd = connect_to(settings.socket_path);
+    if (fd < 0) {
+        result.connected = false;
+        return;
+    }
+    std::minstd_rand engine(seed);
+    std::vector<Clock::time_point> sent_at(settings.requests);
+    result.latencies.reserve(settings.requests);
+
+    unsigned int sent = 0;
+    unsigned int received = 0;
+    std::string in;
+    std::string out;
+    std::vector<std::string> payloads;
+    while (received < settings.requests) {
+        // Keep the pipeline full
+        out.clear();
+        while (sent < settings.requests and sent - received < settings.depth) {
+            sent_at.at(sent) = Clock::now();
+            random_request(sent, settings, engine).append_frame(out);
+            ++sent;
+        }
+        if (not out.empty() and not write_all(fd, out)) {
+            result.connected = false;
+            break;
+        }
+
+        if (not read_some(fd, in) or not take_frames(in, payloads)) {
+            result.connected = false;
+            break;
+        }
+        Clock::time_point now = Clock::now();
+        for (auto& payload : payloads) {
+            MessageReader response(payload);
+            std::uint32_t tag = response.get_u32();
+            Status status = static_cast<Status>(response.get_u8());
+            if (status != Status::ok or tag >= sent) {
+                ++result.errors;
+            }
+            if (tag < sent) {
+                std::chrono::duration<double, std::micro> latency = now - sent_at.at(tag);
+                result.latencies.push_back(latency.count());
+            }
+            ++received;
+        }
+        payloads.clear();
+    }
+    ::close(fd);
+}
+
+double percentile(std::vector<double> const& sorted, double fraction)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted.at(static_cast<std::size_t>(fraction * (sorted.size() - 1)));
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 or argc > 7) {
+        std::cerr << "Usage: " << argv[0] << " <socket path> [clients] [pipeline depth]"
+                  << " [requests per client] [towns] [write percent]" << std::endl;
+        return 1;
+    }
+    load_settings settings;
+    settings.socket_path = argv[1];
+    unsigned int* numbers[] = {&settings.clients, &settings.depth, &settings.requests,
+                               &settings.towns, &settings.write_percent};
+    for (int i = 2; i < argc; ++i) {
+        *numbers[i - 2] = std::stoul(argv[i]);
+    }
+    if (settings.clients == 0 or settings.depth == 0 or settings.towns == 0) {
+        std::cerr << "Clients, pipeline depth and towns must be positive" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Adding " << settings.towns << " towns..." << std::endl;
+    if (not populate(settings)) {
+        std::cerr << "Cannot populate server at " << settings.socket_path << std::endl;
+        return 1;
+    }
+
+    std::vector<client_result> results(settings.clients);
+    std::vector<std::thread> clients;
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < settings.clients; ++i) {
+        clients.emplace_back(run_client, std::cref(settings), i + 1, std::ref(results.at(i)));
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    std::vector<double> latencies;
+    unsigned int errors = 0;
+    unsigned int disconnected = 0;
+    for (auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        errors += result.errors;
+        disconnected += result.connected ? 0 : 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "Clients: " << settings.clients << ", pipeline depth: " << settings.depth
+              << ", write percent: " << settings.write_percent << std::endl;
+    std::cout << "Requests: " << latencies.size() << ", errors: " << errors
+              << ", disconnected clients: " << disconnected << std::endl;
+    std::cout << "Time: " << elapsed.count() << " s, throughput: "
+              << latencies.size() / elapsed.count() << " requests/s" << std::endl;
+    std::cout << "Latency p50: " << percentile(latencies, 0.5) << " us, p99: "
+              << percentile(latencies, 0.99) << " us, max: "
+              << percentile(latencies, 1.0) << " us" << std::endl;
+    return errors == 0 and disconnected == 0 ? 0 : 2;
+}
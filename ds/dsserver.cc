@@ -0,0 +1,58 @@
+// Dsserver.cc
+//
+// Student name: Tuomas Mäkinen
+//
+// Keeps one Datastructures instance and serves it over a Unix-domain socket.
+// Usage: dsserver <socket path> [read threads]
+
+#include "datastructures.hh"
+#include "queryserver.hh"
+
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+QueryServer* running_server = nullptr;
+
+void handle_signal(int)
+{
+    if (running_server != nullptr) {
+        running_server->stop();
+    }
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <socket path> [read threads]" << std::endl;
+        return 1;
+    }
+    std::string socket_path = argv[1];
+    unsigned int read_threads = std::thread::hardware_concurrency();
+    if (argc == 3) {
+        read_threads = std::stoul(argv[2]);
+    }
+
+    Datastructures ds;
+    QueryServer server(ds, read_threads);
+    running_server = &server;
+
+    struct sigaction action = {};
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::cout << "Serving on " << socket_path << " with "
+              << read_threads << " read threads" << std::endl;
+    if (not server.run(socket_path)) {
+        std::cerr << "Cannot listen on " << socket_path << std::endl;
+        return 1;
+    }
+    running_server = nullptr;
+    return 0;
+}
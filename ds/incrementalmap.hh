@@ -0,0 +1,258 @@
+// Incrementalmap.hh
+//
+// Student name: Tuomas Mäkinen
+
+#ifndef INCREMENTALMAP_HH
+#define INCREMENTALMAP_HH
+
+#include "memoryusage.hh"
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// Hash map that can move its entries into a right-sized table a few buckets
+// at a time. During a migration the entries are split between the old and
+// the new table: lookups check both, new entries go to the new table and
+// iteration visits the old table first. Otherwise it behaves like the
+// std::unordered_map it wraps. Entries are moved as nodes, so references to
+// them stay valid.
+template <typename Key, typename T>
+class IncrementalMap
+{
+    using table = std::unordered_map<Key, T>;
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = typename table::value_type;
+    using local_iterator = typename table::local_iterator;
+
+    template <bool Const>
+    class basic_iterator
+    {
+        using table_type = std::conditional_t<Const, table const, table>;
+        using position_type = std::conditional_t<Const, typename table::const_iterator,
+                                                        typename table::iterator>;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename table::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, value_type const*, value_type*>;
+        using reference = std::conditional_t<Const, value_type const&, value_type&>;
+
+        basic_iterator() = default;
+
+        basic_iterator(table_type* old_table, table_type* new_table, bool in_old, position_type position) :
+            old_table_{old_table}, new_table_{new_table}, in_old_{in_old}, position_{position}
+        {
+            skip_old_end();
+        }
+
+        reference operator*() const { return *position_; }
+        pointer operator->() const { return &*position_; }
+
+        basic_iterator& operator++()
+        {
+            ++position_;
+            skip_old_end();
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            basic_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(basic_iterator const& other) const
+        {
+            return in_old_ == other.in_old_ and position_ == other.position_;
+        }
+
+        bool operator!=(basic_iterator const& other) const
+        {
+            return not (*this == other);
+        }
+
+    private:
+        // Continues from the end of the old table to the new one
+        void skip_old_end()
+        {
+            if (in_old_ and position_ == old_table_->end()) {
+                in_old_ = false;
+                position_ = new_table_->begin();
+            }
+        }
+
+        table_type* old_table_ = nullptr;
+        table_type* new_table_ = nullptr;
+        bool in_old_ = false;
+        position_type position_;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    // Estimate of performance: ϴ(1), O(n) worst case
+    // Short rationale for estimate: at most two hash lookups
+    T& at(Key const& key)
+    {
+        auto search = table_.find(key);
+        if (search != table_.end()) {
+            return search->second;
+        }
+        return old_table_.at(key);
+    }
+
+    T const& at(Key const& key) const
+    {
+        auto search = table_.find(key);
+        if (search != table_.end()) {
+            return search->second;
+        }
+        return old_table_.at(key);
+    }
+
+    // Estimate of performance: ϴ(1), O(n) worst case
+    // Short rationale for estimate: at most two hash lookups
+    std::size_t count(Key const& key) const
+    {
+        return table_.count(key) + old_table_.count(key);
+    }
+
+    iterator find(Key const& key)
+    {
+        auto search = table_.find(key);
+        if (search != table_.end()) {
+            return iterator(&old_table_, &table_, false, search);
+        }
+        auto old_search = old_table_.find(key);
+        if (old_search != old_table_.end()) {
+            return iterator(&old_table_, &table_, true, old_search);
+        }
+        return end();
+    }
+
+    // Estimate of performance: ϴ(1) amortized, O(n) worst case
+    // Short rationale for estimate: hash lookups, the new table may rehash
+    std::pair<iterator, bool> insert(value_type const& value)
+    {
+        auto old_search = old_table_.find(value.first);
+        if (old_search != old_table_.end()) {
+            return {iterator(&old_table_, &table_, true, old_search), false};
+        }
+        auto result = table_.insert(value);
+        return {iterator(&old_table_, &table_, false, result.first), result.second};
+    }
+
+    std::size_t erase(Key const& key)
+    {
+        return table_.erase(key) + old_table_.erase(key);
+    }
+
+    std::size_t size() const
+    {
+        return table_.size() + old_table_.size();
+    }
+
+    // Estimate of performance: ϴ(n)
+    // Short rationale for estimate: every entry is destroyed
+    void clear()
+    {
+        table_.clear();
+        table().swap(old_table_);
+        next_bucket_ = 0;
+        migrating_ = false;
+    }
+
+    iterator begin()
+    {
+        return iterator(&old_table_, &table_, true, old_table_.begin());
+    }
+
+    iterator end()
+    {
+        return iterator(&old_table_, &table_, false, table_.end());
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(&old_table_, &table_, true, old_table_.begin());
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(&old_table_, &table_, false, table_.end());
+    }
+
+    // Buckets of the table, they cover every entry only when not migrating
+    std::size_t bucket_count() const { return table_.bucket_count(); }
+    local_iterator begin(std::size_t bucket) { return table_.begin(bucket); }
+    local_iterator end(std::size_t bucket) { return table_.end(bucket); }
+
+    // Buckets and nodes of both tables, like hash_table_bytes()
+    std::size_t table_bytes() const
+    {
+        return hash_table_bytes(table_) + hash_table_bytes(old_table_);
+    }
+
+    // True when at most a quarter of the buckets would be needed. Growth alone
+    // leaves at least half of them in use, so only removals trigger this.
+    bool wastes_buckets() const
+    {
+        return table_.bucket_count() > 4 * table_.size() / table_.max_load_factor() + 1;
+    }
+
+    bool migrating() const
+    {
+        return migrating_;
+    }
+
+    // Starts moving the entries into a table sized for them, nothing is moved yet
+    // Estimate of performance: O(n)
+    // Short rationale for estimate: the bucket array of the new table is allocated
+    void start_migration()
+    {
+        if (migrating_) {
+            return;
+        }
+        table_.swap(old_table_);
+        table_.reserve(old_table_.size());
+        next_bucket_ = 0;
+        migrating_ = true;
+    }
+
+    // Moves the entries of the next buckets of the old table and returns true
+    // when the migration is complete. Removals never rehash the old table, so
+    // the bucket position stays valid between calls. The call that completes
+    // the migration frees the old bucket array, ϴ(n) in one step.
+    // Estimate of performance: O(buckets) on average
+    // Short rationale for estimate: every entry is moved once as a node, without copying
+    bool migrate(std::size_t buckets)
+    {
+        for (; buckets > 0 and next_bucket_ < old_table_.bucket_count(); --buckets, ++next_bucket_) {
+            while (old_table_.begin(next_bucket_) != old_table_.end(next_bucket_)) {
+                table_.insert(old_table_.extract(old_table_.begin(next_bucket_)->first));
+            }
+        }
+        if (next_bucket_ < old_table_.bucket_count()) {
+            return false;
+        }
+        table().swap(old_table_);
+        next_bucket_ = 0;
+        migrating_ = false;
+        return true;
+    }
+
+private:
+    table table_;
+    table old_table_; // Entries not migrated yet, empty when not migrating
+    std::size_t next_bucket_ = 0;
+    bool migrating_ = false;
+};
+
+#endif // INCREMENTALMAP_HH
@@ -0,0 +1,73 @@
+// Memoryusage.hh
+//
+// Student name: Tuomas Mäkinen
+
+#ifndef MEMORYUSAGE_HH
+#define MEMORYUSAGE_HH
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include <set>
+
+// Estimates of the heap memory owned by standard containers. Node sizes
+// follow the libstdc++ layouts, other libraries differ by a few pointers.
+
+inline std::size_t heap_bytes(int)
+{
+    return 0;
+}
+
+inline std::size_t heap_bytes(std::string const& s)
+{
+    // Short strings are stored inside the object itself
+    static std::size_t const inline_capacity = std::string().capacity();
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
+
+template <typename T, typename U>
+std::size_t heap_bytes(std::pair<T, U> const& p)
+{
+    return heap_bytes(p.first) + heap_bytes(p.second);
+}
+
+template <typename T>
+std::size_t heap_bytes(std::vector<T> const& v)
+{
+    std::size_t bytes = v.capacity() * sizeof(T);
+    for (auto& i : v) {
+        bytes += heap_bytes(i);
+    }
+    return bytes;
+}
+
+template <typename T, typename Compare>
+std::size_t heap_bytes(std::set<T, Compare> const& s)
+{
+    // Red-black tree node: color and three links before the value
+    std::size_t bytes = s.size() * (4 * sizeof(void*) + sizeof(T));
+    for (auto& i : s) {
+        bytes += heap_bytes(i);
+    }
+    return bytes;
+}
+
+// Buckets and nodes of an unordered container, memory owned by the
+// elements themselves is left to the caller.
+template <typename Map>
+std::size_t hash_table_bytes(Map const& m)
+{
+    // Node: next link, value and the cached hash code
+    return m.bucket_count() * sizeof(void*)
+            + m.size() * (sizeof(void*) + sizeof(typename Map::value_type) + sizeof(std::size_t));
+}
+
+// Compaction only reallocates containers that waste at least half of their memory
+template <typename T>
+bool wastes_half(std::vector<T> const& v)
+{
+    return v.capacity() > 2 * v.size();
+}
+
+#endif // MEMORYUSAGE_HH
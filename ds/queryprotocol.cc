@@ -0,0 +1,282 @@
+// Queryprotocol.cc
+//
+// Student name: Tuomas Mäkinen
+
+#include "queryprotocol.hh"
+
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+
+bool is_write(Operation op)
+{
+    switch (op) {
+    case Operation::clear_all:
+    case Operation::add_town:
+    case Operation::change_town_name:
+    case Operation::add_vassalship:
+    case Operation::remove_town:
+    case Operation::clear_roads:
+    case Operation::add_road:
+    case Operation::remove_road:
+    case Operation::any_route:
+    case Operation::least_towns_route:
+    case Operation::road_cycle_route:
+    case Operation::compact:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void MessageWriter::put_u8(std::uint8_t value)
+{
+    payload_.push_back(static_cast<char>(value));
+}
+
+void MessageWriter::put_u32(std::uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        put_u8(value >> (8 * i));
+    }
+}
+
+void MessageWriter::put_u64(std::uint64_t value)
+{
+    for (int i = 0; i < 8; ++i) {
+        put_u8(value >> (8 * i));
+    }
+}
+
+void MessageWriter::put_i64(std::int64_t value)
+{
+    put_u64(static_cast<std::uint64_t>(value));
+}
+
+void MessageWriter::put_int(int value)
+{
+    put_u32(static_cast<std::uint32_t>(value));
+}
+
+void MessageWriter::put_bool(bool value)
+{
+    put_u8(value ? 1 : 0);
+}
+
+void MessageWriter::put_string(const std::string &value)
+{
+    put_u32(value.size());
+    payload_.append(value);
+}
+
+void MessageWriter::put_coord(Coord value)
+{
+    put_int(value.x);
+    put_int(value.y);
+}
+
+void MessageWriter::put_ids(const std::vector<TownID> &ids)
+{
+    put_u32(ids.size());
+    for (auto& id : ids) {
+        put_string(id);
+    }
+}
+
+void MessageWriter::put_roads(const std::vector<std::pair<TownID, TownID>> &roads)
+{
+    put_u32(roads.size());
+    for (auto& road : roads) {
+        put_string(road.first);
+        put_string(road.second);
+    }
+}
+
+void MessageWriter::append(const MessageWriter &other)
+{
+    payload_.append(other.payload_);
+}
+
+const std::string &MessageWriter::payload() const
+{
+    return payload_;
+}
+
+void MessageWriter::append_frame(std::string &out) const
+{
+    std::uint32_t size = payload_.size();
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(size >> (8 * i)));
+    }
+    out.append(payload_);
+}
+
+MessageReader::MessageReader(const char *data, std::size_t size) :
+    position_{data}, end_{data + size}
+{
+
+}
+
+MessageReader::MessageReader(const std::string &payload) :
+    MessageReader(payload.data(), payload.size())
+{
+
+}
+
+std::uint8_t MessageReader::get_u8()
+{
+    if (not take(1)) {return 0;}
+    return static_cast<std::uint8_t>(position_[-1]);
+}
+
+std::uint32_t MessageReader::get_u32()
+{
+    if (not take(4)) {return 0;}
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(position_[i - 4])) << (8 * i);
+    }
+    return value;
+}
+
+std::uint64_t MessageReader::get_u64()
+{
+    if (not take(8)) {return 0;}
+    std::uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(position_[i - 8])) << (8 * i);
+    }
+    return value;
+}
+
+std::int64_t MessageReader::get_i64()
+{
+    return static_cast<std::int64_t>(get_u64());
+}
+
+int MessageReader::get_int()
+{
+    return static_cast<int>(get_u32());
+}
+
+bool MessageReader::get_bool()
+{
+    return get_u8() != 0;
+}
+
+std::string MessageReader::get_string()
+{
+    std::uint32_t size = get_u32();
+    if (not take(size)) {return {};}
+    return std::string(position_ - size, size);
+}
+
+Coord MessageReader::get_coord()
+{
+    Coord coord;
+    coord.x = get_int();
+    coord.y = get_int();
+    return coord;
+}
+
+std::vector<TownID> MessageReader::get_ids()
+{
+    std::uint32_t count = get_u32();
+    std::vector<TownID> ids;
+    // Every string takes at least its length field, don't trust larger counts
+    if (count > static_cast<std::size_t>(end_ - position_) / 4) {
+        ok_ = false;
+        return ids;
+    }
+    ids.reserve(count);
+    for (std::uint32_t i = 0; i < count and ok_; ++i) {
+        ids.push_back(get_string());
+    }
+    return ids;
+}
+
+std::vector<std::pair<TownID, TownID>> MessageReader::get_roads()
+{
+    std::uint32_t count = get_u32();
+    std::vector<std::pair<TownID, TownID>> roads;
+    if (count > static_cast<std::size_t>(end_ - position_) / 8) {
+        ok_ = false;
+        return roads;
+    }
+    roads.reserve(count);
+    for (std::uint32_t i = 0; i < count and ok_; ++i) {
+        TownID first = get_string();
+        TownID second = get_string();
+        roads.push_back(std::make_pair(first, second));
+    }
+    return roads;
+}
+
+bool MessageReader::ok() const
+{
+    return ok_;
+}
+
+bool MessageReader::finished() const
+{
+    return ok_ and position_ == end_;
+}
+
+bool MessageReader::take(std::size_t count)
+{
+    if (not ok_ or count > static_cast<std::size_t>(end_ - position_)) {
+        ok_ = false;
+        return false;
+    }
+    position_ += count;
+    return true;
+}
+
+bool take_frames(std::string &buffer, std::vector<std::string> &payloads)
+{
+    std::size_t position = 0;
+    while (buffer.size() - position >= 4) {
+        MessageReader header(buffer.data() + position, 4);
+        std::uint32_t size = header.get_u32();
+        if (size > MAX_PAYLOAD) {
+            return false;
+        }
+        if (buffer.size() - position - 4 < size) {
+            break;
+        }
+        payloads.push_back(buffer.substr(position + 4, size));
+        position += 4 + size;
+    }
+    buffer.erase(0, position);
+    return true;
+}
+
+bool write_all(int fd, const std::string &data)
+{
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = ::send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {continue;}
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+bool read_some(int fd, std::string &buffer)
+{
+    char chunk[64 * 1024];
+    while (true) {
+        ssize_t result = ::read(fd, chunk, sizeof(chunk));
+        if (result < 0 and errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        buffer.append(chunk, result);
+        return true;
+    }
+}
@@ -0,0 +1,125 @@
+// Queryprotocol.hh
+//
+// Student name: Tuomas Mäkinen
+
+#ifndef QUERYPROTOCOL_HH
+#define QUERYPROTOCOL_HH
+
+#include "datastructures.hh"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Binary protocol of the query server. Every message is a frame of
+// u32 payload length followed by the payload, all integers little-endian.
+//
+// Request payload:  u32 tag, u8 operation, arguments
+// Response payload: u32 tag, u8 status, result (only when status is ok)
+//
+// Arguments and results are encoded in the order of the Datastructures
+// parameters: int as i32, long long (tax totals) as i64, unsigned int as
+// u32, bool as u8, strings as u32 length and bytes, Coord as two i32, vectors
+// as u32 count and elements, MemoryUsage as six u64. compact takes its budget as u32 microseconds.
+// Responses on one connection come back in request order, the tag is
+// echoed so that clients do not have to rely on it.
+
+enum class Operation : std::uint8_t
+{
+    town_count, clear_all, add_town, get_town_name, get_town_coordinates,
+    get_town_tax, all_towns, find_towns, change_town_name,
+    towns_alphabetically, towns_distance_increasing, min_distance,
+    max_distance, add_vassalship, get_town_vassals, taxer_path, remove_town,
+    towns_nearest, longest_vassal_path, total_net_tax, clear_roads,
+    all_roads, add_road, get_roads_from, any_route, remove_road,
+    least_towns_route, road_cycle_route, tax_in_rectangle, tax_in_circle,
+    count_in_rectangle, count_in_circle, top_k_tax_in_rectangle,
+    top_k_tax_in_circle, memory_usage, compact,
+    operation_count // Not an operation, number of the ones above
+};
+
+enum class Status : std::uint8_t
+{
+    ok,
+    not_implemented, // NotImplemented was thrown
+    bad_request,     // Unknown operation or malformed arguments
+    failed           // Any other exception
+};
+
+// True for operations that modify the data, route searches included since
+// they mark visited towns. These run one at a time, others in parallel.
+bool is_write(Operation op);
+
+// Largest payload accepted, bigger frames close the connection
+std::uint32_t const MAX_PAYLOAD = 64 * 1024 * 1024;
+
+// Builds a payload
+class MessageWriter
+{
+public:
+    void put_u8(std::uint8_t value);
+    void put_u32(std::uint32_t value);
+    void put_u64(std::uint64_t value);
+    void put_i64(std::int64_t value);
+    void put_int(int value);
+    void put_bool(bool value);
+    void put_string(std::string const& value);
+    void put_coord(Coord value);
+    void put_ids(std::vector<TownID> const& ids);
+    void put_roads(std::vector<std::pair<TownID, TownID>> const& roads);
+    void append(MessageWriter const& other);
+
+    std::string const& payload() const;
+
+    // Appends the payload as a complete frame to out
+    void append_frame(std::string& out) const;
+
+private:
+    std::string payload_;
+};
+
+// Reads a payload, reading past the end sets the reader failed and
+// returns zero values from then on.
+class MessageReader
+{
+public:
+    MessageReader(char const* data, std::size_t size);
+    explicit MessageReader(std::string const& payload);
+
+    std::uint8_t get_u8();
+    std::uint32_t get_u32();
+    std::uint64_t get_u64();
+    std::int64_t get_i64();
+    int get_int();
+    bool get_bool();
+    std::string get_string();
+    Coord get_coord();
+    std::vector<TownID> get_ids();
+    std::vector<std::pair<TownID, TownID>> get_roads();
+
+    // False if a read went past the end
+    bool ok() const;
+    // True if every byte has been read and none past the end
+    bool finished() const;
+
+private:
+    bool take(std::size_t count);
+
+    char const* position_;
+    char const* end_;
+    bool ok_ = true;
+};
+
+// Moves complete frames from the front of buffer into payloads. Returns
+// false if a frame is larger than MAX_PAYLOAD.
+bool take_frames(std::string& buffer, std::vector<std::string>& payloads);
+
+// Writes all of data to a socket, false on error
+bool write_all(int fd, std::string const& data);
+
+// Reads what is available (blocking until something is) and appends it to
+// buffer, false on end of stream or error
+bool read_some(int fd, std::string& buffer);
+
+#endif // QUERYPROTOCOL_HH
@@ -0,0 +1,491 @@
+// Queryserver.cc
+//
+// Student name: Tuomas Mäkinen
+
+#include "queryserver.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+// Smallest number of reads handed to one worker, smaller runs are
+// cheaper to execute directly than to pass between threads
+std::size_t const MIN_READS_PER_TASK = 8;
+
+bool is_write_payload(std::string const& payload)
+{
+    // Malformed requests are answered as reads
+    return payload.size() >= 5 and is_write(static_cast<Operation>(payload[4]));
+}
+}
+
+WorkerPool::WorkerPool(unsigned int threads)
+{
+    for (unsigned int i = 0; i < std::max(threads, 1u); ++i) {
+        threads_.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    available_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+std::future<void> WorkerPool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(packaged));
+    }
+    available_.notify_one();
+    return result;
+}
+
+unsigned int WorkerPool::size() const
+{
+    return threads_.size();
+}
+
+void WorkerPool::work()
+{
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            available_.wait(lock, [this](){ return stopping_ or !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+QueryServer::QueryServer(Datastructures &ds, unsigned int read_threads) :
+    ds_{ds}, readers_{read_threads}
+{
+
+}
+
+QueryServer::~QueryServer()
+{
+
+}
+
+bool QueryServer::run(const std::string &socket_path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    ::unlink(socket_path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+            or ::listen(fd, SOMAXCONN) < 0) {
+        ::close(fd);
+        return false;
+    }
+    listen_fd_ = fd;
+
+    while (not stopping_) {
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR or errno == ECONNABORTED) {continue;}
+            break;
+        }
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        client_fds_.insert(client);
+        std::thread(&QueryServer::serve_client, this, client).detach();
+    }
+    listen_fd_ = -1;
+    ::close(fd);
+    ::unlink(socket_path.c_str());
+
+    // Wake up the clients blocked in read and wait until they are gone
+    std::unique_lock<std::mutex> lock(clients_mutex_);
+    for (int client : client_fds_) {
+        ::shutdown(client, SHUT_RDWR);
+    }
+    clients_done_.wait(lock, [this](){ return client_fds_.empty(); });
+    return true;
+}
+
+void QueryServer::stop()
+{
+    stopping_ = true;
+    int fd = listen_fd_;
+    if (fd >= 0) {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+}
+
+void QueryServer::serve_client(int fd)
+{
+    std::string in;
+    std::string out;
+    std::vector<std::string> payloads;
+    while (not stopping_ and read_some(fd, in)) {
+        if (not take_frames(in, payloads)) {
+            break;
+        }
+        if (payloads.empty()) {
+            continue;
+        }
+        out.clear();
+        execute_batch(payloads, out);
+        payloads.clear();
+        if (not write_all(fd, out)) {
+            break;
+        }
+    }
+    // Closed under the lock, otherwise run() could accept a new client with
+    // the same fd number before it is erased here
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    client_fds_.erase(fd);
+    ::close(fd);
+    clients_done_.notify_all();
+}
+
+void QueryServer::execute_batch(const std::vector<std::string> &payloads, std::string &out)
+{
+    std::vector<std::string> responses(payloads.size());
+    std::size_t first = 0;
+    while (first < payloads.size()) {
+        bool write = is_write_payload(payloads.at(first));
+        std::size_t last = first + 1;
+        while (last < payloads.size() and is_write_payload(payloads.at(last)) == write) {
+            ++last;
+        }
+
+        std::size_t count = last - first;
+        std::size_t tasks = std::min<std::size_t>(readers_.size(), count / MIN_READS_PER_TASK);
+        if (write) {
+            std::unique_lock<std::shared_mutex> lock(data_mutex_);
+            for (std::size_t i = first; i < last; ++i) {
+                responses.at(i) = respond(payloads.at(i));
+            }
+        }
+        else if (tasks <= 1) {
+            std::shared_lock<std::shared_mutex> lock(data_mutex_);
+            for (std::size_t i = first; i < last; ++i) {
+                responses.at(i) = respond(payloads.at(i));
+            }
+        }
+        else {
+            // Contiguous slices so that every worker takes the lock only once
+            std::vector<std::future<void>> done;
+            for (std::size_t task = 0; task < tasks; ++task) {
+                std::size_t begin = first + count * task / tasks;
+                std::size_t end = first + count * (task + 1) / tasks;
+                done.push_back(readers_.submit([this, begin, end, &payloads, &responses](){
+                    std::shared_lock<std::shared_mutex> lock(data_mutex_);
+                    for (std::size_t i = begin; i < end; ++i) {
+                        responses.at(i) = respond(payloads.at(i));
+                    }
+                }));
+            }
+            for (auto& task : done) {
+                task.get();
+            }
+        }
+        first = last;
+    }
+
+    for (auto& response : responses) {
+        out.append(response);
+    }
+}
+
+std::string QueryServer::respond(const std::string &payload)
+{
+    MessageReader args(payload);
+    std::uint32_t tag = args.get_u32();
+    std::uint8_t op = args.get_u8();
+
+    MessageWriter result;
+    Status status = Status::bad_request;
+    if (args.ok() and op < static_cast<std::uint8_t>(Operation::operation_count)) {
+        try {
+            if (dispatch(static_cast<Operation>(op), args, result)) {
+                status = Status::ok;
+            }
+        }
+        catch (NotImplemented const&) {
+            status = Status::not_implemented;
+        }
+        catch (std::exception const&) {
+            status = Status::failed;
+        }
+    }
+
+    MessageWriter response;
+    response.put_u32(tag);
+    response.put_u8(static_cast<std::uint8_t>(status));
+    if (status == Status::ok) {
+        response.append(result);
+    }
+    std::string frame;
+    response.append_frame(frame);
+    return frame;
+}
+
+bool QueryServer::dispatch(Operation op, MessageReader &args, MessageWriter &result)
+{
+    // Arguments are read first and the operation is run only if they
+    // were exactly what the operation expects
+    switch (op) {
+    case Operation::town_count: {
+        if (not args.finished()) {return false;}
+        result.put_u32(ds_.town_count());
+        return true;
+    }
+    case Operation::clear_all: {
+        if (not args.finished()) {return false;}
+        ds_.clear_all();
+        return true;
+    }
+    case Operation::add_town: {
+        TownID id = args.get_string();
+        Name name = args.get_string();
+        Coord coord = args.get_coord();
+        int tax = args.get_int();
+        if (not args.finished()) {return false;}
+        result.put_bool(ds_.add_town(id, name, coord, tax));
+        return true;
+    }
+    case Operation::get_town_name: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_string(ds_.get_town_name(id));
+        return true;
+    }
+    case Operation::get_town_coordinates: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_coord(ds_.get_town_coordinates(id));
+        return true;
+    }
+    case Operation::get_town_tax: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_int(ds_.get_town_tax(id));
+        return true;
+    }
+    case Operation::all_towns: {
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.all_towns());
+        return true;
+    }
+    case Operation::find_towns: {
+        Name name = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.find_towns(name));
+        return true;
+    }
+    case Operation::change_town_name: {
+        TownID id = args.get_string();
+        Name name = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_bool(ds_.change_town_name(id, name));
+        return true;
+    }
+    case Operation::towns_alphabetically: {
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.towns_alphabetically());
+        return true;
+    }
+    case Operation::towns_distance_increasing: {
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.towns_distance_increasing());
+        return true;
+    }
+    case Operation::min_distance: {
+        if (not args.finished()) {return false;}
+        result.put_string(ds_.min_distance());
+        return true;
+    }
+    case Operation::max_distance: {
+        if (not args.finished()) {return false;}
+        result.put_string(ds_.max_distance());
+        return true;
+    }
+    case Operation::add_vassalship: {
+        TownID vassal = args.get_string();
+        TownID master = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_bool(ds_.add_vassalship(vassal, master));
+        return true;
+    }
+    case Operation::get_town_vassals: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.get_town_vassals(id));
+        return true;
+    }
+    case Operation::taxer_path: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.taxer_path(id));
+        return true;
+    }
+    case Operation::remove_town: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_bool(ds_.remove_town(id));
+        return true;
+    }
+    case Operation::towns_nearest: {
+        Coord coord = args.get_coord();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.towns_nearest(coord));
+        return true;
+    }
+    case Operation::longest_vassal_path: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.longest_vassal_path(id));
+        return true;
+    }
+    case Operation::total_net_tax: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_int(ds_.total_net_tax(id));
+        return true;
+    }
+    case Operation::clear_roads: {
+        if (not args.finished()) {return false;}
+        ds_.clear_roads();
+        return true;
+    }
+    case Operation::all_roads: {
+        if (not args.finished()) {return false;}
+        result.put_roads(ds_.all_roads());
+        return true;
+    }
+    case Operation::add_road: {
+        TownID town1 = args.get_string();
+        TownID town2 = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_bool(ds_.add_road(town1, town2));
+        return true;
+    }
+    case Operation::get_roads_from: {
+        TownID id = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.get_roads_from(id));
+        return true;
+    }
+    case Operation::any_route: {
+        TownID from = args.get_string();
+        TownID to = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.any_route(from, to));
+        return true;
+    }
+    case Operation::remove_road: {
+        TownID town1 = args.get_string();
+        TownID town2 = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_bool(ds_.remove_road(town1, town2));
+        return true;
+    }
+    case Operation::least_towns_route: {
+        TownID from = args.get_string();
+        TownID to = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.least_towns_route(from, to));
+        return true;
+    }
+    case Operation::road_cycle_route: {
+        TownID start = args.get_string();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.road_cycle_route(start));
+        return true;
+    }
+    case Operation::tax_in_rectangle: {
+        Coord corner1 = args.get_coord();
+        Coord corner2 = args.get_coord();
+        if (not args.finished()) {return false;}
+        result.put_i64(ds_.tax_in_region(corner1, corner2));
+        return true;
+    }
+    case Operation::tax_in_circle: {
+        Coord center = args.get_coord();
+        Distance radius = args.get_int();
+        if (not args.finished()) {return false;}
+        result.put_i64(ds_.tax_in_region(center, radius));
+        return true;
+    }
+    case Operation::count_in_rectangle: {
+        Coord corner1 = args.get_coord();
+        Coord corner2 = args.get_coord();
+        if (not args.finished()) {return false;}
+        result.put_u32(ds_.count_in_region(corner1, corner2));
+        return true;
+    }
+    case Operation::count_in_circle: {
+        Coord center = args.get_coord();
+        Distance radius = args.get_int();
+        if (not args.finished()) {return false;}
+        result.put_u32(ds_.count_in_region(center, radius));
+        return true;
+    }
+    case Operation::top_k_tax_in_rectangle: {
+        Coord corner1 = args.get_coord();
+        Coord corner2 = args.get_coord();
+        unsigned int k = args.get_u32();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.top_k_tax_in_region(corner1, corner2, k));
+        return true;
+    }
+    case Operation::top_k_tax_in_circle: {
+        Coord center = args.get_coord();
+        Distance radius = args.get_int();
+        unsigned int k = args.get_u32();
+        if (not args.finished()) {return false;}
+        result.put_ids(ds_.top_k_tax_in_region(center, radius, k));
+        return true;
+    }
+    case Operation::memory_usage: {
+        if (not args.finished()) {return false;}
+        MemoryUsage usage = ds_.memory_usage();
+        result.put_u64(usage.towns);
+        result.put_u64(usage.names);
+        result.put_u64(usage.distances);
+        result.put_u64(usage.regions);
+        result.put_u64(usage.roads);
+        result.put_u64(usage.vassals);
+        return true;
+    }
+    case Operation::compact: {
+        std::uint32_t budget = args.get_u32();
+        if (not args.finished()) {return false;}
+        result.put_bool(ds_.compact(std::chrono::microseconds(budget)));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
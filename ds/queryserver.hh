@@ -0,0 +1,83 @@
+// Queryserver.hh
+//
+// Student name: Tuomas Mäkinen
+
+#ifndef QUERYSERVER_HH
+#define QUERYSERVER_HH
+
+#include "datastructures.hh"
+#include "queryprotocol.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed number of threads running submitted tasks in order of submission
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned int threads);
+    ~WorkerPool();
+
+    std::future<void> submit(std::function<void()> task);
+    unsigned int size() const;
+
+private:
+    void work();
+
+    std::vector<std::thread> threads_;
+    std::queue<std::packaged_task<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+    bool stopping_ = false;
+};
+
+// Serves the public operations of one Datastructures instance over a
+// Unix-domain socket using the protocol in queryprotocol.hh.
+//
+// Every client has its own thread which reads all pipelined requests that
+// have arrived and executes them as a batch. The batch is split into runs of
+// consecutive reads and writes, keeping the client's order. Reads of a run
+// are spread over the worker pool and share the data, a run of writes holds
+// the data exclusively, so writes of all clients are serialized. Responses
+// of the batch are sent back in one write.
+class QueryServer
+{
+public:
+    QueryServer(Datastructures& ds, unsigned int read_threads);
+    ~QueryServer();
+
+    // Listens on socket_path (replacing an old socket file) until stop() is
+    // called and all clients are gone. False if the socket couldn't be set up.
+    bool run(std::string const& socket_path);
+
+    // Safe to call from a signal handler
+    void stop();
+
+private:
+    void serve_client(int fd);
+    void execute_batch(std::vector<std::string> const& payloads, std::string& out);
+    std::string respond(std::string const& payload);
+    bool dispatch(Operation op, MessageReader& args, MessageWriter& result);
+
+    Datastructures& ds_;
+    std::shared_mutex data_mutex_;
+    WorkerPool readers_;
+
+    std::atomic<bool> stopping_{false};
+    std::atomic<int> listen_fd_{-1};
+
+    std::mutex clients_mutex_;
+    std::condition_variable clients_done_;
+    std::set<int> client_fds_;
+};
+
+#endif // QUERYSERVER_HH
@@ -0,0 +1,683 @@
+// Regionindex.cc
+//
+// Student name: Tuomas Mäkinen
+
+#include "datastructures.hh"
+#include "memoryusage.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <queue>
+
+namespace
+{
+// Weight balance of the scapegoat rebuilds, a child subtree may hold
+// at most this fraction of its parent's nodes.
+double const BALANCE_ALPHA = 0.7;
+
+// Compaction builds ranges up to this size in one step with nth_element,
+// larger ones are partitioned a piece at a time.
+std::size_t const SMALL_RANGE = 512;
+
+// Pivot of a large range is the median of this many evenly spaced towns
+std::size_t const PIVOT_SAMPLES = 31;
+
+// Towns copied, partitioned or freed between clock checks
+unsigned int const CLOCK_CHECK_INTERVAL = 256;
+
+// Radius is an int, so (radius + 1)^2 <= 2^62 and anything at least 2^31
+// away along one axis is outside every circle. Below that the squared
+// distance fits in long long.
+long long const CIRCLE_REACH = 1LL << 31;
+
+long long square(long long value)
+{
+    return value * value;
+}
+}
+
+RegionIndex::RegionIndex()
+{
+
+}
+
+RegionIndex::~RegionIndex()
+{
+
+}
+
+bool RegionIndex::insert(const TownID &id, Coord coord, int tax)
+{
+    if (node_of_town_.count(id) != 0) {
+        return false;
+    }
+    if (compaction_step_ == compaction_step::copy or compaction_step_ == compaction_step::split) {
+        changed_towns_.insert(id);
+    }
+    int n = new_node(id, coord, tax);
+    node_of_town_.insert({id, n});
+    if (root_ == NO_NODE) {
+        root_ = n;
+        return true;
+    }
+
+    // Aggregates are updated on the way down, the new town is in every subtree on the path
+    int current = root_;
+    unsigned int depth = 0;
+    while (true) {
+        node& c = nodes_[current];
+        ++c.size_;
+        ++c.count_;
+        c.tax_sum_ += tax;
+        c.max_tax_ = std::max(c.max_tax_, tax);
+        c.min_ = {std::min(c.min_.x, coord.x), std::min(c.min_.y, coord.y)};
+        c.max_ = {std::max(c.max_.x, coord.x), std::max(c.max_.y, coord.y)};
+        ++depth;
+
+        bool go_left = c.split_y_ ? coord.y < c.coord_.y : coord.x < c.coord_.x;
+        int& child = go_left ? c.left_ : c.right_;
+        if (child == NO_NODE) {
+            child = n;
+            nodes_[n].parent_ = current;
+            nodes_[n].split_y_ = not c.split_y_;
+            break;
+        }
+        current = child;
+    }
+
+    if (depth > max_depth()) {
+        // Rebuild the lowest subtree on the path that is out of balance
+        int child = n;
+        int parent = nodes_[n].parent_;
+        int scapegoat = NO_NODE;
+        while (parent != NO_NODE) {
+            if (nodes_[child].size_ > BALANCE_ALPHA * nodes_[parent].size_) {
+                scapegoat = parent;
+                break;
+            }
+            child = parent;
+            parent = nodes_[parent].parent_;
+        }
+        if (scapegoat != NO_NODE) {
+            rebuild(scapegoat);
+        }
+    }
+    return true;
+}
+
+bool RegionIndex::erase(const TownID &id)
+{
+    auto search = node_of_town_.find(id);
+    if (search == node_of_town_.end()) {
+        return false;
+    }
+    if (compaction_step_ == compaction_step::copy or compaction_step_ == compaction_step::split) {
+        changed_towns_.insert(id);
+    }
+    int n = search->second;
+    node_of_town_.erase(search);
+    nodes_[n].alive_ = false;
+    ++dead_count_;
+    pull_to_root(n);
+
+    if (dead_count_ * 2 > nodes_[root_].size_) {
+        rebuild_all();
+    }
+    return true;
+}
+
+void RegionIndex::clear()
+{
+    // Fresh containers, so that an empty index holds no memory
+    std::vector<node>().swap(nodes_);
+    std::vector<int>().swap(free_nodes_);
+    std::unordered_map<TownID, int>().swap(node_of_town_);
+    root_ = NO_NODE;
+    dead_count_ = 0;
+    end_compaction();
+}
+
+unsigned int RegionIndex::size() const
+{
+    return node_of_town_.size();
+}
+
+std::size_t RegionIndex::memory_usage() const
+{
+    std::size_t bytes = nodes_.capacity() * sizeof(node)
+            + free_nodes_.capacity() * sizeof(int)
+            + hash_table_bytes(node_of_town_);
+    // Dead and free nodes keep their ids until the next rebuild
+    for (auto& i : nodes_) {
+        bytes += heap_bytes(i.id_);
+    }
+    for (auto& i : node_of_town_) {
+        bytes += heap_bytes(i.first);
+    }
+    // Containers of a compaction in progress
+    bytes += heap_bytes(compacted_order_) + hash_table_bytes(compacted_node_of_town_)
+            + hash_table_bytes(changed_towns_)
+            + compacted_nodes_.capacity() * sizeof(node)
+            + split_ranges_.capacity() * sizeof(split_range)
+            + split_nodes_.capacity() * sizeof(int);
+    for (auto& i : compacted_nodes_) {
+        bytes += 2 * heap_bytes(i.id_);
+    }
+    for (auto& i : changed_towns_) {
+        bytes += heap_bytes(i);
+    }
+    return bytes;
+}
+
+bool RegionIndex::needs_compaction() const
+{
+    // Slots are only left unused by removals, capacity from vector growth is not counted.
+    // Growth of the map leaves at least half of its buckets in use.
+    return compaction_step_ != compaction_step::idle
+            or 2 * (dead_count_ + free_nodes_.size()) > node_of_town_.size()
+            or node_of_town_.bucket_count() > 4 * node_of_town_.size() / node_of_town_.max_load_factor() + 1;
+}
+
+bool RegionIndex::compact(std::chrono::steady_clock::time_point deadline)
+{
+    unsigned int work = 0;
+    auto out_of_time = [&work, deadline](unsigned int amount) {
+        work += amount;
+        if (work < CLOCK_CHECK_INTERVAL) {
+            return false;
+        }
+        work = 0;
+        return std::chrono::steady_clock::now() >= deadline;
+    };
+    auto key = [this](int n, bool split_y) {
+        return split_y ? compacted_nodes_[n].coord_.y : compacted_nodes_[n].coord_.x;
+    };
+    auto attach = [this](split_range const& range, int n) {
+        if (range.parent_ == NO_NODE) {
+            compacted_root_ = n;
+        }
+        else if (range.left_) {
+            compacted_nodes_[range.parent_].left_ = n;
+        }
+        else {
+            compacted_nodes_[range.parent_].right_ = n;
+        }
+    };
+
+    if (compaction_step_ == compaction_step::idle) {
+        // Some room for towns inserted during compaction, the rest are left to
+        // the replay so that the containers never grow in the middle of a call
+        std::size_t capacity = size() + size() / 16 + 1;
+        compacted_nodes_.reserve(capacity);
+        compacted_node_of_town_.reserve(capacity);
+        compacted_order_.reserve(capacity);
+        next_slot_ = 0;
+        compacted_root_ = NO_NODE;
+        compaction_step_ = compaction_step::copy;
+    }
+
+    if (compaction_step_ == compaction_step::copy) {
+        // Slots keep their towns between calls, only rebuild_all() renumbers
+        // them and it ends the compaction. A town copied twice because it was
+        // erased and inserted again is in changed_towns_ anyway.
+        for (; next_slot_ < nodes_.size(); ++next_slot_) {
+            if (out_of_time(1)) {return false;}
+            node const& n = nodes_[next_slot_];
+            if (not n.alive_ or compacted_node_of_town_.count(n.id_) != 0) {
+                continue;
+            }
+            if (compacted_nodes_.size() == compacted_nodes_.capacity()) {
+                changed_towns_.insert(n.id_);
+                continue;
+            }
+            compacted_node_of_town_.insert({n.id_, static_cast<int>(compacted_nodes_.size())});
+            compacted_order_.push_back(compacted_nodes_.size());
+            compacted_nodes_.push_back(n);
+        }
+        split_ranges_.push_back({0, compacted_order_.size(), false, NO_NODE, false});
+        compaction_step_ = compaction_step::split;
+    }
+
+    while (not split_ranges_.empty()) {
+        split_range& range = split_ranges_.back();
+        if (range.last_ - range.first_ <= SMALL_RANGE) {
+            split_range small = range;
+            split_ranges_.pop_back();
+            attach(small, build(compacted_nodes_, compacted_order_, small.first_, small.last_,
+                                small.split_y_, small.parent_));
+            if (out_of_time(small.last_ - small.first_)) {return false;}
+            continue;
+        }
+
+        if (not range.started_) {
+            // Pivot is moved to the end of the range for the partition
+            std::pair<int, std::size_t> samples[PIVOT_SAMPLES];
+            for (std::size_t i = 0; i < PIVOT_SAMPLES; ++i) {
+                std::size_t position = range.first_ + i * (range.last_ - range.first_ - 1) / (PIVOT_SAMPLES - 1);
+                samples[i] = {key(compacted_order_[position], range.split_y_), position};
+            }
+            std::nth_element(samples, samples + PIVOT_SAMPLES / 2, samples + PIVOT_SAMPLES);
+            std::swap(compacted_order_[samples[PIVOT_SAMPLES / 2].second], compacted_order_[range.last_ - 1]);
+            range.pivot_ = key(compacted_order_[range.last_ - 1], range.split_y_);
+            range.store_ = range.first_;
+            range.scan_ = range.first_;
+            range.started_ = true;
+        }
+        while (range.scan_ < range.last_ - 1) {
+            if (out_of_time(1)) {return false;}
+            int scanned = key(compacted_order_[range.scan_], range.split_y_);
+            // Queries only rely on bounding boxes, so towns equal to the pivot
+            // can go to either side. Alternating keeps duplicates balanced.
+            if (scanned < range.pivot_ or (scanned == range.pivot_ and range.scan_ % 2 == 0)) {
+                std::swap(compacted_order_[range.store_], compacted_order_[range.scan_]);
+                ++range.store_;
+            }
+            ++range.scan_;
+        }
+
+        split_range done = range;
+        split_ranges_.pop_back();
+        std::swap(compacted_order_[done.store_], compacted_order_[done.last_ - 1]);
+        int n = compacted_order_[done.store_];
+        compacted_nodes_[n].split_y_ = done.split_y_;
+        compacted_nodes_[n].parent_ = done.parent_;
+        attach(done, n);
+        split_nodes_.push_back(n);
+        split_ranges_.push_back({done.first_, done.store_, not done.split_y_, n, true});
+        split_ranges_.push_back({done.store_ + 1, done.last_, not done.split_y_, n, false});
+    }
+    if (compaction_step_ == compaction_step::split) {
+        swap_compacted();
+    }
+
+    // Elements of the old containers are destroyed a piece at a time, their
+    // buffers are freed at once by end_compaction()
+    while (not compacted_nodes_.empty()) {
+        if (out_of_time(1)) {return false;}
+        compacted_nodes_.pop_back();
+    }
+    while (not compacted_node_of_town_.empty()) {
+        if (out_of_time(1)) {return false;}
+        compacted_node_of_town_.erase(compacted_node_of_town_.begin());
+    }
+    end_compaction();
+    return true;
+}
+
+long long RegionIndex::tax_in_rectangle(Coord corner1, Coord corner2) const
+{
+    unsigned int count = 0;
+    long long tax_sum = 0;
+    aggregate(make_rectangle(corner1, corner2), count, tax_sum);
+    return tax_sum;
+}
+
+unsigned int RegionIndex::count_in_rectangle(Coord corner1, Coord corner2) const
+{
+    unsigned int count = 0;
+    long long tax_sum = 0;
+    aggregate(make_rectangle(corner1, corner2), count, tax_sum);
+    return count;
+}
+
+std::vector<TownID> RegionIndex::top_k_tax_in_rectangle(Coord corner1, Coord corner2, unsigned int k) const
+{
+    return top_k(make_rectangle(corner1, corner2), k);
+}
+
+long long RegionIndex::tax_in_circle(Coord center, Distance radius) const
+{
+    unsigned int count = 0;
+    long long tax_sum = 0;
+    aggregate(make_circle(center, radius), count, tax_sum);
+    return tax_sum;
+}
+
+unsigned int RegionIndex::count_in_circle(Coord center, Distance radius) const
+{
+    unsigned int count = 0;
+    long long tax_sum = 0;
+    aggregate(make_circle(center, radius), count, tax_sum);
+    return count;
+}
+
+std::vector<TownID> RegionIndex::top_k_tax_in_circle(Coord center, Distance radius, unsigned int k) const
+{
+    return top_k(make_circle(center, radius), k);
+}
+
+bool RegionIndex::rectangle::contains(Coord c) const
+{
+    return min_.x <= c.x and c.x <= max_.x and min_.y <= c.y and c.y <= max_.y;
+}
+
+bool RegionIndex::rectangle::contains(Coord min, Coord max) const
+{
+    return contains(min) and contains(max);
+}
+
+bool RegionIndex::rectangle::intersects(Coord min, Coord max) const
+{
+    return min.x <= max_.x and min_.x <= max.x and min.y <= max_.y and min_.y <= max.y;
+}
+
+bool RegionIndex::circle::contains(Coord c) const
+{
+    return within(std::llabs(static_cast<long long>(c.x) - center_.x),
+                  std::llabs(static_cast<long long>(c.y) - center_.y));
+}
+
+bool RegionIndex::circle::contains(Coord min, Coord max) const
+{
+    // Box is inside when its farthest corner is
+    long long dx = std::max(std::llabs(static_cast<long long>(min.x) - center_.x),
+                            std::llabs(static_cast<long long>(max.x) - center_.x));
+    long long dy = std::max(std::llabs(static_cast<long long>(min.y) - center_.y),
+                            std::llabs(static_cast<long long>(max.y) - center_.y));
+    return within(dx, dy);
+}
+
+bool RegionIndex::circle::intersects(Coord min, Coord max) const
+{
+    // Distance to the nearest point of the box
+    long long dx = 0;
+    long long dy = 0;
+    if (center_.x < min.x) { dx = static_cast<long long>(min.x) - center_.x; }
+    else if (center_.x > max.x) { dx = static_cast<long long>(center_.x) - max.x; }
+    if (center_.y < min.y) { dy = static_cast<long long>(min.y) - center_.y; }
+    else if (center_.y > max.y) { dy = static_cast<long long>(center_.y) - max.y; }
+    return within(dx, dy);
+}
+
+bool RegionIndex::circle::within(long long dx, long long dy) const
+{
+    if (dx >= CIRCLE_REACH or dy >= CIRCLE_REACH) {
+        return false;
+    }
+    return square(dx) + square(dy) < limit_;
+}
+
+RegionIndex::rectangle RegionIndex::make_rectangle(Coord corner1, Coord corner2)
+{
+    return {{std::min(corner1.x, corner2.x), std::min(corner1.y, corner2.y)},
+            {std::max(corner1.x, corner2.x), std::max(corner1.y, corner2.y)}};
+}
+
+RegionIndex::circle RegionIndex::make_circle(Coord center, Distance radius)
+{
+    // Distances are floored, so floor(sqrt(d2)) <= radius when d2 < (radius+1)^2
+    if (radius < 0) {
+        return {center, 0};
+    }
+    return {center, square(static_cast<long long>(radius) + 1)};
+}
+
+template <typename Region>
+void RegionIndex::aggregate(const Region &region, unsigned int &count, long long &tax_sum) const
+{
+    std::vector<int> stack;
+    if (root_ != NO_NODE) {
+        stack.push_back(root_);
+    }
+    while (!stack.empty()) {
+        node const& n = nodes_[stack.back()];
+        stack.pop_back();
+        if (n.count_ == 0 or not region.intersects(n.min_, n.max_)) {
+            continue;
+        }
+        if (region.contains(n.min_, n.max_)) {
+            count += n.count_;
+            tax_sum += n.tax_sum_;
+            continue;
+        }
+        if (n.alive_ and region.contains(n.coord_)) {
+            ++count;
+            tax_sum += n.tax_;
+        }
+        if (n.left_ != NO_NODE) { stack.push_back(n.left_); }
+        if (n.right_ != NO_NODE) { stack.push_back(n.right_); }
+    }
+}
+
+template <typename Region>
+std::vector<TownID> RegionIndex::top_k(const Region &region, unsigned int k) const
+{
+    // Candidate is either a single town or a whole subtree keyed by its maximum tax.
+    // Equal keys expand subtrees first so that ties come out in TownID order.
+    struct candidate {
+        int key;
+        bool town;
+        int n;
+    };
+    auto lower_priority = [this](candidate const& a, candidate const& b) {
+        if (a.key != b.key) { return a.key < b.key; }
+        if (a.town != b.town) { return a.town; }
+        return a.town and nodes_[a.n].id_ > nodes_[b.n].id_;
+    };
+    std::priority_queue<candidate, std::vector<candidate>, decltype(lower_priority)> queue(lower_priority);
+
+    auto push_subtree = [&](int n) {
+        if (n != NO_NODE and nodes_[n].count_ != 0 and region.intersects(nodes_[n].min_, nodes_[n].max_)) {
+            queue.push({nodes_[n].max_tax_, false, n});
+        }
+    };
+
+    std::vector<TownID> result;
+    if (k == 0) {
+        return result;
+    }
+    push_subtree(root_);
+    while (!queue.empty() and result.size() < k) {
+        candidate c = queue.top();
+        queue.pop();
+        node const& n = nodes_[c.n];
+        if (c.town) {
+            result.push_back(n.id_);
+            continue;
+        }
+        if (n.alive_ and region.contains(n.coord_)) {
+            queue.push({n.tax_, true, c.n});
+        }
+        push_subtree(n.left_);
+        push_subtree(n.right_);
+    }
+    return result;
+}
+
+int RegionIndex::new_node(const TownID &id, Coord coord, int tax)
+{
+    node new_node;
+    new_node.id_ = id;
+    new_node.coord_ = coord;
+    new_node.tax_ = tax;
+    new_node.tax_sum_ = tax;
+    new_node.max_tax_ = tax;
+    new_node.min_ = coord;
+    new_node.max_ = coord;
+
+    if (!free_nodes_.empty()) {
+        int n = free_nodes_.back();
+        free_nodes_.pop_back();
+        nodes_[n] = new_node;
+        return n;
+    }
+    nodes_.push_back(new_node);
+    return nodes_.size() - 1;
+}
+
+void RegionIndex::pull(std::vector<node> &nodes, int n)
+{
+    node& x = nodes[n];
+    x.size_ = 1;
+    x.count_ = x.alive_ ? 1 : 0;
+    x.tax_sum_ = x.alive_ ? x.tax_ : 0;
+    x.max_tax_ = x.alive_ ? x.tax_ : NO_VALUE;
+    x.min_ = x.coord_;
+    x.max_ = x.coord_;
+    for (int child : {x.left_, x.right_}) {
+        if (child == NO_NODE) {
+            continue;
+        }
+        node const& c = nodes[child];
+        x.size_ += c.size_;
+        x.count_ += c.count_;
+        x.tax_sum_ += c.tax_sum_;
+        x.max_tax_ = std::max(x.max_tax_, c.max_tax_);
+        x.min_ = {std::min(x.min_.x, c.min_.x), std::min(x.min_.y, c.min_.y)};
+        x.max_ = {std::max(x.max_.x, c.max_.x), std::max(x.max_.y, c.max_.y)};
+    }
+}
+
+void RegionIndex::pull_to_root(int n)
+{
+    while (n != NO_NODE) {
+        pull(nodes_, n);
+        n = nodes_[n].parent_;
+    }
+}
+
+void RegionIndex::rebuild(int n)
+{
+    int parent = nodes_[n].parent_;
+    bool split_y = nodes_[n].split_y_;
+    std::vector<int> alive;
+    collect_alive(n, alive);
+    int new_root = build(nodes_, alive, 0, alive.size(), split_y, parent);
+
+    if (parent == NO_NODE) {
+        root_ = new_root;
+    }
+    else if (nodes_[parent].left_ == n) {
+        nodes_[parent].left_ = new_root;
+    }
+    else {
+        nodes_[parent].right_ = new_root;
+    }
+    // Dead nodes were dropped, so sizes above the subtree changed
+    pull_to_root(parent);
+}
+
+void RegionIndex::rebuild_all()
+{
+    // Slots are renumbered, so a compaction in progress would miss towns
+    end_compaction();
+
+    // Copying the alive nodes into a fresh vector also releases the dead slots
+    std::vector<int> alive;
+    if (root_ != NO_NODE) {
+        collect_alive(root_, alive);
+    }
+    std::vector<node> compacted;
+    compacted.reserve(alive.size());
+    for (unsigned int i = 0; i < alive.size(); ++i) {
+        compacted.push_back(nodes_[alive[i]]);
+        node_of_town_.at(compacted.back().id_) = i;
+        alive[i] = i;
+    }
+    nodes_.swap(compacted);
+    free_nodes_.clear();
+    free_nodes_.shrink_to_fit();
+    dead_count_ = 0;
+    root_ = build(nodes_, alive, 0, alive.size(), false, NO_NODE);
+}
+
+void RegionIndex::collect_alive(int n, std::vector<int> &alive)
+{
+    std::vector<int> stack = {n};
+    while (!stack.empty()) {
+        int current = stack.back();
+        stack.pop_back();
+        node const& x = nodes_[current];
+        if (x.left_ != NO_NODE) { stack.push_back(x.left_); }
+        if (x.right_ != NO_NODE) { stack.push_back(x.right_); }
+        if (x.alive_) {
+            alive.push_back(current);
+        }
+        else {
+            free_nodes_.push_back(current);
+            --dead_count_;
+        }
+    }
+}
+
+int RegionIndex::build(std::vector<node> &nodes, std::vector<int> &alive,
+                       std::size_t first, std::size_t last, bool split_y, int parent)
+{
+    if (first == last) {
+        return NO_NODE;
+    }
+    std::size_t middle = first + (last - first) / 2;
+    std::nth_element(alive.begin() + first, alive.begin() + middle, alive.begin() + last,
+                     [&nodes, split_y](int a, int b) {
+        return split_y ? nodes[a].coord_.y < nodes[b].coord_.y
+                       : nodes[a].coord_.x < nodes[b].coord_.x;
+    });
+    int n = alive[middle];
+    nodes[n].split_y_ = split_y;
+    nodes[n].parent_ = parent;
+    nodes[n].left_ = build(nodes, alive, first, middle, not split_y, n);
+    nodes[n].right_ = build(nodes, alive, middle + 1, last, not split_y, n);
+    pull(nodes, n);
+    return n;
+}
+
+unsigned int RegionIndex::max_depth() const
+{
+    // Depth bound of an alpha weight balanced tree
+    return std::floor(std::log(nodes_[root_].size_) / std::log(1 / BALANCE_ALPHA)) + 1;
+}
+
+void RegionIndex::swap_compacted()
+{
+    // Aggregates of the large ranges' nodes, children before parents
+    for (auto i = split_nodes_.rbegin(); i != split_nodes_.rend(); ++i) {
+        pull(compacted_nodes_, *i);
+    }
+
+    // Current state of the towns changed during compaction, before the swap
+    std::vector<node> changed;
+    changed.reserve(changed_towns_.size());
+    for (auto& id : changed_towns_) {
+        auto search = node_of_town_.find(id);
+        if (search != node_of_town_.end()) {
+            changed.push_back(nodes_[search->second]);
+        }
+        else {
+            changed.push_back(node());
+            changed.back().id_ = id;
+            changed.back().alive_ = false;
+        }
+    }
+
+    nodes_.swap(compacted_nodes_);
+    node_of_town_.swap(compacted_node_of_town_);
+    root_ = compacted_root_;
+    std::vector<int>().swap(free_nodes_);
+    dead_count_ = 0;
+    std::vector<int>().swap(compacted_order_);
+    std::vector<split_range>().swap(split_ranges_);
+    std::vector<int>().swap(split_nodes_);
+    std::unordered_set<TownID>().swap(changed_towns_);
+    compaction_step_ = compaction_step::release;
+
+    for (auto& town : changed) {
+        erase(town.id_);
+        if (town.alive_) {
+            insert(town.id_, town.coord_, town.tax_);
+        }
+    }
+}
+
+void RegionIndex::end_compaction()
+{
+    compaction_step_ = compaction_step::idle;
+    next_slot_ = 0;
+    std::vector<node>().swap(compacted_nodes_);
+    std::unordered_map<TownID, int>().swap(compacted_node_of_town_);
+    std::vector<int>().swap(compacted_order_);
+    std::vector<split_range>().swap(split_ranges_);
+    std::vector<int>().swap(split_nodes_);
+    compacted_root_ = NO_NODE;
+    std::unordered_set<TownID>().swap(changed_towns_);
+}
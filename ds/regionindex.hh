@@ -0,0 +1,187 @@
+// Regionindex.hh
+//
+// Student name: Tuomas Mäkinen
+
+#ifndef REGIONINDEX_HH
+#define REGIONINDEX_HH
+
+// Included by datastructures.hh after the common types (TownID, Coord, ...)
+// have been defined, include datastructures.hh instead of this file.
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// Aggregate-augmented k-d tree over town coordinates. Every node keeps the
+// town count, tax sum, maximum tax and bounding box of its subtree, so
+// regions that fully cover a subtree are answered without visiting it.
+// Balance is kept with scapegoat-style partial rebuilds, removed towns are
+// only marked dead and the whole tree is rebuilt once half of it is dead.
+class RegionIndex
+{
+public:
+    RegionIndex();
+    ~RegionIndex();
+
+    // Estimate of performance: O(log(n)) amortized
+    // Short rationale for estimate: descent of a depth-bounded tree,
+    // occasional subtree rebuilds are paid by the inserts that unbalanced it.
+    bool insert(TownID const& id, Coord coord, int tax);
+
+    // Estimate of performance: O(log(n)) amortized
+    // Short rationale for estimate: aggregates are updated on the path to the root,
+    // full rebuild happens only after n/2 removals.
+    bool erase(TownID const& id);
+
+    // Estimate of performance: ϴ(n)
+    // Short rationale for estimate: clear() is linear
+    // in the size of the container.
+    void clear();
+
+    // Estimate of performance: ϴ(1)
+    // Short rationale for estimate: count is stored in the root
+    unsigned int size() const;
+
+    // Estimate of performance: ϴ(n)
+    // Short rationale for estimate: heap memory of every node's TownID is added
+    std::size_t memory_usage() const;
+
+    // True while compaction is in progress, or when removals have left more
+    // node slots dead or free than half the live towns, or three quarters of
+    // the buckets unused.
+    // Estimate of performance: ϴ(1)
+    // Short rationale for estimate: compares stored sizes
+    bool needs_compaction() const;
+
+    // Does compaction until deadline and returns true when it is complete.
+    // Live towns are copied into containers sized for them and a tree is built
+    // there one range at a time, then the containers are swapped and the old
+    // elements destroyed a piece at a time. Towns inserted or erased in between
+    // are reapplied to the new tree when it is swapped in. Reserving the new
+    // containers and freeing the old node vector and bucket array are single
+    // steps that the deadline does not bound.
+    // Estimate of performance: O(nlog(n)) in total, O(c log(n)) for the swapping call
+    // Short rationale for estimate: every level of the tree partitions the towns
+    // once, the c towns changed during compaction are inserted again.
+    bool compact(std::chrono::steady_clock::time_point deadline);
+
+    // Rectangle is given by any two opposite corners, borders are included.
+    // Tax totals are 64-bit, so sums of int taxes cannot overflow.
+    // Estimate of performance: O(sqrt(n))
+    // Short rationale for estimate: k-d tree range search, fully covered
+    // subtrees are summed from their aggregates.
+    long long tax_in_rectangle(Coord corner1, Coord corner2) const;
+    unsigned int count_in_rectangle(Coord corner1, Coord corner2) const;
+
+    // Estimate of performance: O((sqrt(n) + k)log(n))
+    // Short rationale for estimate: best-first search ordered by the maximum tax
+    // of subtrees, priority queue operations are logarithmic.
+    std::vector<TownID> top_k_tax_in_rectangle(Coord corner1, Coord corner2, unsigned int k) const;
+
+    // Circle contains towns whose distance (as in towns_nearest) from center
+    // is at most radius.
+    // Estimate of performance: O(sqrt(n))
+    // Short rationale for estimate: same as the rectangle versions
+    long long tax_in_circle(Coord center, Distance radius) const;
+    unsigned int count_in_circle(Coord center, Distance radius) const;
+    std::vector<TownID> top_k_tax_in_circle(Coord center, Distance radius, unsigned int k) const;
+
+    // Region shapes of the queries above, also used for scanning towns
+    // when there is no index.
+    struct rectangle {
+        Coord min_;
+        Coord max_;
+        bool contains(Coord c) const;
+        bool contains(Coord min, Coord max) const;
+        bool intersects(Coord min, Coord max) const;
+    };
+
+    struct circle {
+        Coord center_;
+        long long limit_; // Squared distances below this are inside
+        bool contains(Coord c) const;
+        bool contains(Coord min, Coord max) const;
+        bool intersects(Coord min, Coord max) const;
+        // True if the point at axis distances dx, dy (not negative) is inside
+        bool within(long long dx, long long dy) const;
+    };
+
+    static rectangle make_rectangle(Coord corner1, Coord corner2);
+    static circle make_circle(Coord center, Distance radius);
+
+private:
+
+    static int const NO_NODE = -1;
+
+    struct node {
+        TownID id_;
+        Coord coord_;
+        int tax_;
+        bool alive_ = true;
+        bool split_y_ = false;
+        int left_ = NO_NODE;
+        int right_ = NO_NODE;
+        int parent_ = NO_NODE;
+        // Subtree aggregates, size_ counts dead nodes too
+        unsigned int size_ = 1;
+        unsigned int count_ = 1;
+        long long tax_sum_ = 0;
+        int max_tax_ = NO_VALUE;
+        Coord min_;
+        Coord max_;
+    };
+
+    template <typename Region>
+    void aggregate(Region const& region, unsigned int& count, long long& tax_sum) const;
+    template <typename Region>
+    std::vector<TownID> top_k(Region const& region, unsigned int k) const;
+
+    // Range of compacted_order_ waiting to become a subtree. Large ranges are
+    // partitioned around a sampled median over several calls.
+    struct split_range {
+        std::size_t first_;
+        std::size_t last_;
+        bool split_y_;
+        int parent_;
+        bool left_;        // Side of parent_ the subtree goes to
+        bool started_ = false;
+        int pivot_ = 0;
+        std::size_t store_ = 0; // Elements before this are left of the pivot
+        std::size_t scan_ = 0;  // Elements before this have been partitioned
+    };
+
+    enum class compaction_step { idle, copy, split, release };
+
+    int new_node(TownID const& id, Coord coord, int tax);
+    static void pull(std::vector<node>& nodes, int n);
+    void pull_to_root(int n);
+    void rebuild(int n);
+    void rebuild_all();
+    void collect_alive(int n, std::vector<int>& alive);
+    static int build(std::vector<node>& nodes, std::vector<int>& alive,
+                     std::size_t first, std::size_t last, bool split_y, int parent);
+    unsigned int max_depth() const;
+    void swap_compacted();
+    void end_compaction();
+
+    std::vector<node> nodes_;
+    std::vector<int> free_nodes_;
+    std::unordered_map<TownID, int> node_of_town_;
+    int root_ = NO_NODE;
+    unsigned int dead_count_ = 0;
+
+    // Progress of compact() between calls
+    compaction_step compaction_step_ = compaction_step::idle;
+    std::size_t next_slot_ = 0;
+    std::vector<node> compacted_nodes_;
+    std::unordered_map<TownID, int> compacted_node_of_town_;
+    std::vector<int> compacted_order_;
+    std::vector<split_range> split_ranges_;
+    std::vector<int> split_nodes_; // Nodes of large ranges, parents before children
+    int compacted_root_ = NO_NODE;
+    std::unordered_set<TownID> changed_towns_;
+};
+
+#endif // REGIONINDEX_HH